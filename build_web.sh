@@ -1,6 +1,7 @@
 . "c:\raylib\emsdk\emsdk_env.sh"
 mkdir -p web-build
 emcc src/*.cpp -o web-build/index.html \
+  -std=c++17 \
   -IC:/raylib/raylib/src \
   libraylib.web.a \
   -DPLATFORM_WEB \
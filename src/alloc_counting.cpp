@@ -0,0 +1,31 @@
+#include <cstdlib>
+#include <new>
+
+#include "alloc_stats.h"
+
+// Replaces the global operator new with one that counts into alloc_stats.cpp.
+// Only the binaries that want allocation counts list this file among their
+// sources, it is never part of TetrisEngine, where the linker would pull it
+// into every program.
+[[maybe_unused]] static const bool allocCountingEnabled = EnableAllocCounting();
+
+void* operator new(std::size_t size)
+{
+    CountAllocation(size);
+    void* memory = malloc(size ? size : 1);
+    if (!memory)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void* memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    free(memory);
+}
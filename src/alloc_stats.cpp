@@ -0,0 +1,160 @@
+#include <cstddef>
+#include <fstream>
+
+#include "alloc_stats.h"
+
+// Per thread so engine worker threads do not show up in the frame counts
+static thread_local AllocCounters allocCounters = {0, 0};
+
+// Set once alloc_counting.cpp is linked in, constant-initialized so it is
+// already false before any static constructor runs
+static bool allocCounting = false;
+
+bool EnableAllocCounting()
+{
+    allocCounting = true;
+    return true;
+}
+
+void CountAllocation(std::size_t bytes)
+{
+    allocCounters.count++;
+    allocCounters.bytes += bytes;
+}
+
+bool AllocStatsEnabled()
+{
+    return allocCounting;
+}
+
+AllocCounters GetAllocCounters()
+{
+    return allocCounters;
+}
+
+const char* GetAllocPhaseName(AllocPhase phase)
+{
+    static const char* names[numAllocPhases] = {"Update", "HandleInput", "Draw", "GridDraw", "DrawUI", "DrawGhostPiece", "FileIO"};
+    return phase >= 0 && phase < numAllocPhases ? names[phase] : "Unknown";
+}
+
+static AllocCounters Difference(const AllocCounters& end, const AllocCounters& start)
+{
+    return AllocCounters{end.count - start.count, end.bytes - start.bytes};
+}
+
+static void Accumulate(AllocCounters& into, const AllocCounters& counters)
+{
+    into.count += counters.count;
+    into.bytes += counters.bytes;
+}
+
+static void KeepPeak(AllocCounters& peak, const AllocCounters& counters)
+{
+    if (counters.count > peak.count || (counters.count == peak.count && counters.bytes > peak.bytes))
+    {
+        peak = counters;
+    }
+}
+
+FrameAllocStats::FrameAllocStats()
+{
+    Reset();
+}
+
+void FrameAllocStats::Reset()
+{
+    frameStart = GetAllocCounters();
+    lastFrame = peakFrame = totalFrames = AllocCounters{0, 0};
+    for (int i = 0; i < numAllocPhases; i++)
+    {
+        currentPhases[i] = lastPhases[i] = peakPhases[i] = totalPhases[i] = AllocCounters{0, 0};
+    }
+    frameCount = 0;
+}
+
+void FrameAllocStats::BeginFrame()
+{
+    frameStart = GetAllocCounters();
+    for (int i = 0; i < numAllocPhases; i++)
+    {
+        currentPhases[i] = AllocCounters{0, 0};
+    }
+}
+
+void FrameAllocStats::EndFrame()
+{
+    lastFrame = Difference(Difference(GetAllocCounters(), frameStart), currentPhases[PhaseFileIO]);
+    KeepPeak(peakFrame, lastFrame);
+    Accumulate(totalFrames, lastFrame);
+    for (int i = 0; i < numAllocPhases; i++)
+    {
+        lastPhases[i] = currentPhases[i];
+        KeepPeak(peakPhases[i], currentPhases[i]);
+        Accumulate(totalPhases[i], currentPhases[i]);
+    }
+    frameCount++;
+}
+
+void FrameAllocStats::AddToPhase(AllocPhase phase, const AllocCounters& counters)
+{
+    Accumulate(currentPhases[phase], counters);
+}
+
+const AllocCounters& FrameAllocStats::GetLastFrame() const
+{
+    return lastFrame;
+}
+
+const AllocCounters& FrameAllocStats::GetPeakFrame() const
+{
+    return peakFrame;
+}
+
+const AllocCounters& FrameAllocStats::GetLastPhase(AllocPhase phase) const
+{
+    return lastPhases[phase];
+}
+
+const AllocCounters& FrameAllocStats::GetPeakPhase(AllocPhase phase) const
+{
+    return peakPhases[phase];
+}
+
+const AllocCounters& FrameAllocStats::GetTotalPhase(AllocPhase phase) const
+{
+    return totalPhases[phase];
+}
+
+uint64_t FrameAllocStats::GetFrameCount() const
+{
+    return frameCount;
+}
+
+bool FrameAllocStats::Export(const std::string& path) const
+{
+    std::ofstream file(path);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    file << "phase,frames,total_allocs,total_bytes,peak_allocs,peak_bytes\n";
+    file << "Frame," << frameCount << "," << totalFrames.count << "," << totalFrames.bytes << "," << peakFrame.count << "," << peakFrame.bytes << "\n";
+    for (int i = 0; i < numAllocPhases; i++)
+    {
+        file << GetAllocPhaseName((AllocPhase)i) << "," << frameCount << "," << totalPhases[i].count << "," << totalPhases[i].bytes << ","
+             << peakPhases[i].count << "," << peakPhases[i].bytes << "\n";
+    }
+    return (bool)file;
+}
+
+AllocScope::AllocScope(FrameAllocStats& stats, AllocPhase phase) : stats(stats), phase(phase)
+{
+    start = GetAllocCounters();
+}
+
+AllocScope::~AllocScope()
+{
+    stats.AddToPhase(phase, Difference(GetAllocCounters(), start));
+}
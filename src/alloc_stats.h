@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Heap allocation accounting. A binary that links alloc_counting.cpp replaces
+// the global operator new with one that counts every allocation made by the
+// calling thread, in any other binary all counters stay at zero.
+
+struct AllocCounters
+{
+    uint64_t count;
+    uint64_t bytes;
+};
+
+enum AllocPhase
+{
+    PhaseUpdate,
+    PhaseHandleInput,
+    PhaseDraw,
+    PhaseGridDraw,
+    PhaseDrawUI,
+    PhaseDrawGhostPiece,
+    PhaseFileIO, // saving scores and replays, reported but left out of the frame budget
+    numAllocPhases
+};
+
+bool AllocStatsEnabled();
+AllocCounters GetAllocCounters();
+
+// Called by the counting operator new only
+bool EnableAllocCounting();
+void CountAllocation(std::size_t bytes);
+const char* GetAllocPhaseName(AllocPhase phase);
+
+// Allocations per frame and per phase, phases nest so Draw includes GridDraw
+class FrameAllocStats
+{
+public:
+    FrameAllocStats();
+    void Reset();
+    void BeginFrame();
+    void EndFrame();
+    void AddToPhase(AllocPhase phase, const AllocCounters& counters);
+
+    const AllocCounters& GetLastFrame() const;
+    const AllocCounters& GetPeakFrame() const;
+    const AllocCounters& GetLastPhase(AllocPhase phase) const;
+    const AllocCounters& GetPeakPhase(AllocPhase phase) const;
+    const AllocCounters& GetTotalPhase(AllocPhase phase) const;
+    uint64_t GetFrameCount() const;
+    bool Export(const std::string& path) const;
+
+private:
+    AllocCounters frameStart;
+    AllocCounters lastFrame;  // whole frame without PhaseFileIO
+    AllocCounters peakFrame;
+    AllocCounters totalFrames;
+    AllocCounters currentPhases[numAllocPhases];
+    AllocCounters lastPhases[numAllocPhases];
+    AllocCounters peakPhases[numAllocPhases];
+    AllocCounters totalPhases[numAllocPhases];
+    uint64_t frameCount;
+};
+
+// Adds the allocations made during its lifetime to one phase
+class AllocScope
+{
+public:
+    AllocScope(FrameAllocStats& stats, AllocPhase phase);
+    ~AllocScope();
+
+    AllocScope(const AllocScope&) = delete;
+    AllocScope& operator=(const AllocScope&) = delete;
+
+private:
+    FrameAllocStats& stats;
+    AllocPhase phase;
+    AllocCounters start;
+};
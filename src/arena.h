@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Pool of T handed out one at a time and taken back all at once. Objects live in
+// chunks of chunkSize that are created the first time a search needs them and
+// kept after Reset, so once the pool has grown to the largest search no further
+// search touches the heap. Allocate returns an object still holding whatever it
+// held before: the caller overwrites it. Pointers stay valid until Reset.
+template <typename T>
+class Arena
+{
+public:
+    explicit Arena(int chunkSize = 1024);
+    T* Allocate();
+    void Reset();
+    size_t GetAllocated() const;
+    size_t GetMemoryUsage() const;
+
+private:
+    std::vector<std::unique_ptr<T[]>> chunks;
+    int chunkSize;
+    size_t allocated;
+};
+
+template <typename T>
+Arena<T>::Arena(int chunkSize)
+{
+    this->chunkSize = chunkSize;
+    allocated = 0;
+}
+
+template <typename T>
+T* Arena<T>::Allocate()
+{
+    size_t chunk = allocated / chunkSize;
+    if (chunk == chunks.size())
+    {
+        chunks.emplace_back(new T[chunkSize]);
+    }
+    return &chunks[chunk][allocated++ % chunkSize];
+}
+
+template <typename T>
+void Arena<T>::Reset()
+{
+    allocated = 0;
+}
+
+template <typename T>
+size_t Arena<T>::GetAllocated() const
+{
+    return allocated;
+}
+
+template <typename T>
+size_t Arena<T>::GetMemoryUsage() const
+{
+    return chunks.size() * chunkSize * sizeof(T);
+}
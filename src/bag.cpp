@@ -0,0 +1,89 @@
+#include "bag.h"
+
+PieceBag::PieceBag()
+{
+    Seed(0);
+}
+
+PieceBag::PieceBag(uint64_t seed)
+{
+    Seed(seed);
+}
+
+void PieceBag::Seed(uint64_t seed)
+{
+    // splitmix64 scrambles the seed so nearby seeds give unrelated sequences,
+    // xorshift needs a non-zero state
+    uint64_t z = seed + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    state = (z ^ (z >> 31)) | 1;
+
+    FillBag(pieces);
+    FillBag(pieces + numBlockTypes);
+    position = 0;
+}
+
+int PieceBag::Next()
+{
+    int id = pieces[position];
+    position++;
+    if (position == numBlockTypes)
+    {
+        // The next bag becomes current and a fresh one is shuffled behind it
+        for (int i = 0; i < numBlockTypes; i++)
+        {
+            pieces[i] = pieces[numBlockTypes + i];
+        }
+        FillBag(pieces + numBlockTypes);
+        position = 0;
+    }
+    return id;
+}
+
+int PieceBag::Peek(int ahead) const
+{
+    // Up to one full bag ahead is already shuffled, further peeks run a copy forward
+    if (position + ahead < 2 * numBlockTypes)
+    {
+        return pieces[position + ahead];
+    }
+
+    PieceBag copy = *this;
+    for (int i = 0; i < ahead; i++)
+    {
+        copy.Next();
+    }
+    return copy.Next();
+}
+
+int PieceBag::GetBagPosition() const
+{
+    return position;
+}
+
+uint32_t PieceBag::NextRandom()
+{
+    // xorshift64*
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return (uint32_t)((state * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+void PieceBag::FillBag(uint8_t* bag)
+{
+    for (int i = 0; i < numBlockTypes; i++)
+    {
+        bag[i] = (uint8_t)(i + 1);
+    }
+
+    // Fisher-Yates shuffle, the bound is applied with a multiply instead of a modulo
+    for (int i = numBlockTypes - 1; i > 0; i--)
+    {
+        int j = (int)(((uint64_t)NextRandom() * (uint64_t)(i + 1)) >> 32);
+        uint8_t swap = bag[i];
+        bag[i] = bag[j];
+        bag[j] = swap;
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include "blocks.h"
+
+// Seedable 7-bag piece generator. Each bag holds every block id once in a
+// random order. The state is a plain value: copy it to fork the sequence,
+// and generators with different seeds never share state.
+class PieceBag
+{
+public:
+    PieceBag();
+    explicit PieceBag(uint64_t seed);
+    void Seed(uint64_t seed);
+    int Next();
+    int Peek(int ahead) const;
+    int GetBagPosition() const;
+
+private:
+    uint32_t NextRandom();
+    void FillBag(uint8_t* bag);
+
+    uint64_t state;
+    uint8_t pieces[2 * numBlockTypes]; // the current bag followed by the next one
+    int position;
+};
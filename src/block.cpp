@@ -2,23 +2,18 @@
 
 Block::Block()
 {
-    cellSize = 30;
+    id = 0;
     rotationState = 0;
     rowOffset = 0;
     columnOffset = 0;
-    colors = GetCellColors();
-    rowOffset = 0;
-    columnOffset = 0;
 }
 
-void Block::Draw(int offsetX, int offsetY)
+Block::Block(int id)
 {
-    std::vector<Position> tiles = GetCellPositions();
-    static const int blockGridPadding = gridThickness+1;
-    for(Position item: tiles)
-    {
-        DrawRectangle(offsetX + item.column * cellSize + 10 + blockGridPadding, offsetY + item.row * cellSize + 10 + blockGridPadding, cellSize - blockGridPadding, cellSize - blockGridPadding, colors[id]);
-    }
+    this->id = id;
+    rotationState = 0;
+    rowOffset = blockShapes[id].spawnRow;
+    columnOffset = blockShapes[id].spawnColumn;
 }
 
 void Block::Move(int rows, int columns)
@@ -27,40 +22,43 @@ void Block::Move(int rows, int columns)
     columnOffset += columns;
 }
 
-std::vector<Position> Block::GetCellPositions()
+BlockCells Block::GetCellPositions() const
 {
-    if (cells.find(rotationState) == cells.end()) {
-        return std::vector<Position>(); // Return empty vector if rotation state doesn't exist
-    }
-    
-    std::vector<Position> tiles = cells[rotationState];
-    std::vector<Position> movedTiles;
-    for(Position item : tiles)
+    const BlockRotation& rotation = GetRotation();
+    BlockCells tiles;
+    for (int i = 0; i < 4; i++)
     {
-        Position newPos = Position(item.row + rowOffset, item.column + columnOffset);
-        movedTiles.push_back(newPos);
+        tiles[i] = Position(rotation.cells[i].row + rowOffset, rotation.cells[i].column + columnOffset);
     }
-    return movedTiles;
+    return tiles;
+}
+
+const BlockRotation& Block::GetRotation() const
+{
+    return blockShapes[id].rotations[rotationState];
+}
+
+int Block::GetRowOffset() const
+{
+    return rowOffset;
+}
+
+int Block::GetColumnOffset() const
+{
+    return columnOffset;
+}
+
+int Block::GetRotationState() const
+{
+    return rotationState;
 }
 
 void Block::Rotate()
 {
-    if (cells.empty()) return;
-    
-    rotationState++;
-    if(rotationState == (int)cells.size())
-    {
-        rotationState = 0;
-    }
+    rotationState = (rotationState + 1) % numRotations;
 }
 
 void Block::UndoRotation()
 {
-    if (cells.empty()) return;
-    
-    rotationState--;
-    if(rotationState == -1)
-    {
-        rotationState = cells.size() - 1;
-    }
+    rotationState = (rotationState + numRotations - 1) % numRotations;
 }
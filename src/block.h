@@ -1,26 +1,33 @@
 #pragma once
 
-#include <vector>
-#include <map>
+#include <array>
+#include <type_traits>
 #include "position.h"
-#include "globals.h"
+#include "blocks.h"
+
+typedef std::array<Position, 4> BlockCells;
 
 class Block
 {
     public:
         Block();
-        void Draw(int offsetX, int offsetY);
+        explicit Block(int id);
+        void Draw(int offsetX, int offsetY) const;
         void Move(int rows, int columns);
-        std::vector<Position> GetCellPositions();
+        BlockCells GetCellPositions() const;
+        const BlockRotation& GetRotation() const;
+        int GetRowOffset() const;
+        int GetColumnOffset() const;
+        int GetRotationState() const;
         void Rotate();
         void UndoRotation();
         int id;
-        std::map<int, std::vector<Position>> cells;
 
     private:
-        int cellSize;
         int rotationState;
-        std::vector<Color> colors;
         int rowOffset;
-        int columnOffset;      
-};
\ No newline at end of file
+        int columnOffset;
+};
+
+// Blocks are plain values, copying one never touches the heap
+static_assert(std::is_trivially_copyable<Block>::value, "Block must stay trivially copyable");
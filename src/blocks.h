@@ -1,101 +1,136 @@
-#include "block.h"
+#pragma once
+
+#include <cstdint>
 #include "position.h"
 
-class LBlock : public Block 
-{
-    public:
-        LBlock() 
-        {
-            id = 1;
-            cells[0] = {Position{0, 2}, Position(1, 0), Position(1, 1), Position(1, 2)};
-            cells[1] = {Position{0, 1}, Position(1, 1), Position(2, 1), Position(2, 2)};
-            cells[2] = {Position{1, 0}, Position(1, 1), Position(1, 2), Position(2, 0)};
-            cells[3] = {Position{0, 0}, Position(0, 1), Position(1, 1), Position(2, 1)};
-            Move(1, 3);
-        }
-};
+const int numBlockTypes = 7;
+const int numRotations = 4;
 
-class JBlock : public Block 
+// One rotation state of a tetromino, relative to the top-left of its 4x4 box
+struct BlockRotation
 {
-    public:
-        JBlock()
-        {
-            id = 2;
-            cells[0] = {Position{0, 0}, Position(1, 0), Position(1, 1), Position(1, 2)};
-            cells[1] = {Position{0, 1}, Position(0, 2), Position(1, 1), Position(2, 1)};
-            cells[2] = {Position{1, 0}, Position(1, 1), Position(1, 2), Position(2, 2)};
-            cells[3] = {Position{0, 1}, Position(1, 1), Position(2, 0), Position(2, 1)};
-            Move(1, 3);
-        }
+    Position cells[4];
+    uint16_t rowMasks[4]; // bit c is set when column c of that box row is filled
+    int columnBottoms[4]; // lowest filled box row of each box column, -1 when empty
+    int minRow;
+    int maxRow;
+    int minColumn;
+    int maxColumn;
 };
 
-class IBlock : public Block 
+const int maxKicks = 5;
+
+// Wall kicks for each clockwise turn, indexed by the rotation state turned from.
+// Offsets are (rows, columns) with rows growing downward and are tried in order,
+// the first one that leaves the block inside the board and clear of the stack wins.
+struct KickTable
 {
-    public:
-        IBlock()
-        {
-            id = 3;
-            cells[0] = {Position{1, 0}, Position(1, 1), Position(1, 2), Position(1, 3)};
-            cells[1] = {Position{0, 2}, Position(1, 2), Position(2, 2), Position(3, 2)};
-            cells[2] = {Position{2, 0}, Position(2, 1), Position(2, 2), Position(2, 3)};
-            cells[3] = {Position{0, 1}, Position(1, 1), Position(2, 1), Position(3, 1)};          
-            Move(0, 3);
-        }
+    int numKicks;
+    Position offsets[numRotations][maxKicks];
 };
 
-class OBlock : public Block
+// SRS kicks, J, L, S, T and Z share one table
+inline constexpr KickTable standardKicks =
 {
-    public:
-        OBlock()
-        {
-            id = 4;
-            cells[0] = {Position{0, 0}, Position(0, 1), Position(1, 0), Position(1, 1)};
-            cells[1] = {Position{0, 0}, Position(0, 1), Position(1, 0), Position(1, 1)};
-            cells[2] = {Position{0, 0}, Position(0, 1), Position(1, 0), Position(1, 1)};
-            cells[3] = {Position{0, 0}, Position(0, 1), Position(1, 0), Position(1, 1)};             
-            Move(1, 4);
-        }
+    5,
+    {
+        {Position(0, 0), Position(0, -1), Position(-1, -1), Position(2, 0), Position(2, -1)},
+        {Position(0, 0), Position(0, 1), Position(1, 1), Position(-2, 0), Position(-2, 1)},
+        {Position(0, 0), Position(0, 1), Position(-1, 1), Position(2, 0), Position(2, 1)},
+        {Position(0, 0), Position(0, -1), Position(1, -1), Position(-2, 0), Position(-2, -1)},
+    }
 };
 
-class SBlock : public Block 
+inline constexpr KickTable iKicks =
 {
-    public:
-        SBlock()
-        {
-            id = 5;
-            cells[0] = {Position{0, 1}, Position(0, 2), Position(1, 0), Position(1, 1)};
-            cells[1] = {Position{0, 1}, Position(1, 1), Position(1, 2), Position(2, 2)};
-            cells[2] = {Position{1, 1}, Position(1, 2), Position(2, 0), Position(2, 1)};
-            cells[3] = {Position{0, 0}, Position(1, 0), Position(1, 1), Position(2, 1)};          
-            Move(1, 3);
-        }
+    5,
+    {
+        {Position(0, 0), Position(0, -2), Position(0, 1), Position(1, -2), Position(-2, 1)},
+        {Position(0, 0), Position(0, -1), Position(0, 2), Position(-2, -1), Position(1, 2)},
+        {Position(0, 0), Position(0, 2), Position(0, -1), Position(-1, 2), Position(2, -1)},
+        {Position(0, 0), Position(0, 1), Position(0, -2), Position(2, 1), Position(-1, -2)},
+    }
 };
 
-class TBlock : public Block
+// O turns in place
+inline constexpr KickTable noKicks = {1, {}};
+
+struct BlockShape
 {
-    public:
-        TBlock()
-        {
-            id = 6;
-            cells[0] = {Position{0, 1}, Position(1, 0), Position(1, 1), Position(1, 2)};
-            cells[1] = {Position{0, 1}, Position(1, 1), Position(1, 2), Position(2, 1)};
-            cells[2] = {Position{1, 0}, Position(1, 1), Position(1, 2), Position(2, 1)};
-            cells[3] = {Position{0, 1}, Position(1, 0), Position(1, 1), Position(2, 1)};          
-            Move(1, 3);
-        }
+    BlockRotation rotations[numRotations];
+    int spawnRow;
+    int spawnColumn;
+    const KickTable* kicks;
 };
 
-class ZBlock : public  Block
+constexpr BlockRotation MakeRotation(Position a, Position b, Position c, Position d)
 {
-    public:
-        ZBlock()
-        {
-            id = 7;
-            cells[0] = {Position{0, 0}, Position(0, 1), Position(1, 1), Position(1, 2)};
-            cells[1] = {Position{0, 2}, Position(1, 1), Position(1, 2), Position(2, 1)};
-            cells[2] = {Position{1, 0}, Position(1, 1), Position(2, 1), Position(2, 2)};
-            cells[3] = {Position{0, 1}, Position(1, 0), Position(1, 1), Position(2, 0)};          
-            Move(1, 3);
-        }
+    BlockRotation rotation = {{a, b, c, d}, {0, 0, 0, 0}, {-1, -1, -1, -1}, 3, 0, 3, 0};
+    for (int i = 0; i < 4; i++)
+    {
+        const Position& cell = rotation.cells[i];
+        rotation.rowMasks[cell.row] = (uint16_t)(rotation.rowMasks[cell.row] | (1 << cell.column));
+        rotation.columnBottoms[cell.column] = cell.row > rotation.columnBottoms[cell.column] ? cell.row : rotation.columnBottoms[cell.column];
+        rotation.minRow = cell.row < rotation.minRow ? cell.row : rotation.minRow;
+        rotation.maxRow = cell.row > rotation.maxRow ? cell.row : rotation.maxRow;
+        rotation.minColumn = cell.column < rotation.minColumn ? cell.column : rotation.minColumn;
+        rotation.maxColumn = cell.column > rotation.maxColumn ? cell.column : rotation.maxColumn;
+    }
+    return rotation;
+}
 
-};
\ No newline at end of file
+// Shape tables shared by every block, indexed by block id (0 is the empty cell)
+inline constexpr BlockShape blockShapes[numBlockTypes + 1] =
+{
+    // Empty
+    {{}, 0, 0, &noKicks},
+    // L
+    {{
+        MakeRotation(Position(0, 2), Position(1, 0), Position(1, 1), Position(1, 2)),
+        MakeRotation(Position(0, 1), Position(1, 1), Position(2, 1), Position(2, 2)),
+        MakeRotation(Position(1, 0), Position(1, 1), Position(1, 2), Position(2, 0)),
+        MakeRotation(Position(0, 0), Position(0, 1), Position(1, 1), Position(2, 1)),
+    }, 1, 3, &standardKicks},
+    // J
+    {{
+        MakeRotation(Position(0, 0), Position(1, 0), Position(1, 1), Position(1, 2)),
+        MakeRotation(Position(0, 1), Position(0, 2), Position(1, 1), Position(2, 1)),
+        MakeRotation(Position(1, 0), Position(1, 1), Position(1, 2), Position(2, 2)),
+        MakeRotation(Position(0, 1), Position(1, 1), Position(2, 0), Position(2, 1)),
+    }, 1, 3, &standardKicks},
+    // I
+    {{
+        MakeRotation(Position(1, 0), Position(1, 1), Position(1, 2), Position(1, 3)),
+        MakeRotation(Position(0, 2), Position(1, 2), Position(2, 2), Position(3, 2)),
+        MakeRotation(Position(2, 0), Position(2, 1), Position(2, 2), Position(2, 3)),
+        MakeRotation(Position(0, 1), Position(1, 1), Position(2, 1), Position(3, 1)),
+    }, 0, 3, &iKicks},
+    // O
+    {{
+        MakeRotation(Position(0, 0), Position(0, 1), Position(1, 0), Position(1, 1)),
+        MakeRotation(Position(0, 0), Position(0, 1), Position(1, 0), Position(1, 1)),
+        MakeRotation(Position(0, 0), Position(0, 1), Position(1, 0), Position(1, 1)),
+        MakeRotation(Position(0, 0), Position(0, 1), Position(1, 0), Position(1, 1)),
+    }, 1, 4, &noKicks},
+    // S
+    {{
+        MakeRotation(Position(0, 1), Position(0, 2), Position(1, 0), Position(1, 1)),
+        MakeRotation(Position(0, 1), Position(1, 1), Position(1, 2), Position(2, 2)),
+        MakeRotation(Position(1, 1), Position(1, 2), Position(2, 0), Position(2, 1)),
+        MakeRotation(Position(0, 0), Position(1, 0), Position(1, 1), Position(2, 1)),
+    }, 1, 3, &standardKicks},
+    // T
+    {{
+        MakeRotation(Position(0, 1), Position(1, 0), Position(1, 1), Position(1, 2)),
+        MakeRotation(Position(0, 1), Position(1, 1), Position(1, 2), Position(2, 1)),
+        MakeRotation(Position(1, 0), Position(1, 1), Position(1, 2), Position(2, 1)),
+        MakeRotation(Position(0, 1), Position(1, 0), Position(1, 1), Position(2, 1)),
+    }, 1, 3, &standardKicks},
+    // Z
+    {{
+        MakeRotation(Position(0, 0), Position(0, 1), Position(1, 1), Position(1, 2)),
+        MakeRotation(Position(0, 2), Position(1, 1), Position(1, 2), Position(2, 1)),
+        MakeRotation(Position(1, 0), Position(1, 1), Position(2, 1), Position(2, 2)),
+        MakeRotation(Position(0, 1), Position(1, 0), Position(1, 1), Position(2, 0)),
+    }, 1, 3, &standardKicks},
+};
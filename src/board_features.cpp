@@ -0,0 +1,331 @@
+#include <algorithm>
+#include <bitset>
+#include "board_features.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define TETRIS_FEATURES_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TETRIS_TARGET(name)
+#else
+#define TETRIS_TARGET(name) __attribute__((target(name)))
+#endif
+#endif
+
+// Masks shared by every kernel: a full row, the 9 neighbouring column pairs, a
+// row with both walls added, and the boundaries between the 12 cells of that row
+static const uint16_t fullRow = Grid::fullRowMask;
+static const uint16_t columnPairs = fullRow >> 1;
+static const uint16_t leftWall = 1;
+static const uint16_t rightWall = (uint16_t)(1 << (defNumCols + 1));
+static const uint16_t wallBoundaries = (uint16_t)((1 << (defNumCols + 1)) - 1);
+static const uint16_t lastColumn = (uint16_t)(1 << (defNumCols - 1));
+
+BoardBatch::BoardBatch()
+{
+    // Kernels read whole vectors, so the lanes past count must hold something
+    std::fill(&rows[0][0], &rows[0][0] + defNumRows * boardBatchSize, (uint16_t)0);
+    count = 0;
+}
+
+void BoardBatch::Clear()
+{
+    count = 0;
+}
+
+int BoardBatch::Add(const Grid& grid)
+{
+    // Returns the board's index, or -1 when the batch is full
+    if (count == boardBatchSize)
+    {
+        return -1;
+    }
+    const Grid::RowMask* masks = grid.GetRowMasks();
+    for (int row = 0; row < defNumRows; row++)
+    {
+        rows[row][count] = masks[row];
+    }
+    return count++;
+}
+
+BoardFeatures BatchFeatures::Get(int board) const
+{
+    return BoardFeatures{aggregateHeight[board], maxHeight[board], holes[board], bumpiness[board],
+                         rowTransitions[board], columnTransitions[board], wells[board]};
+}
+
+static int Popcount(uint16_t bits)
+{
+    return (int)std::bitset<16>(bits).count();
+}
+
+// The reference every other kernel is checked against. Each row updates the
+// cells covered from above, and every feature is a popcount of masks built from
+// the row, the row above and the covered cells.
+static BoardFeatures EvaluateRows(const uint16_t* const* rows, int board)
+{
+    BoardFeatures features = {0, 0, 0, 0, 0, 0, 0};
+    uint16_t covered = 0;
+    uint16_t above = 0;
+    int r = 0;
+    // Empty rows above the stack only have the two changes at the walls
+    while (r < defNumRows && rows[r][board] == 0)
+    {
+        features.rowTransitions += 2;
+        r++;
+    }
+    for (; r < defNumRows; r++)
+    {
+        uint16_t row = rows[r][board];
+        covered |= row;
+        features.aggregateHeight += Popcount(covered);
+        features.maxHeight += covered != 0;
+        features.holes += Popcount((uint16_t)(covered & ~row));
+        features.bumpiness += Popcount((uint16_t)((covered ^ (covered >> 1)) & columnPairs));
+        uint16_t walled = (uint16_t)((row << 1) | leftWall | rightWall);
+        features.rowTransitions += Popcount((uint16_t)((walled ^ (walled >> 1)) & wallBoundaries));
+        features.columnTransitions += Popcount((uint16_t)(row ^ above));
+        uint16_t sides = (uint16_t)(((row << 1) | leftWall) & ((row >> 1) | lastColumn));
+        features.wells += Popcount((uint16_t)(~covered & sides & fullRow));
+        above = row;
+    }
+    features.columnTransitions += Popcount((uint16_t)(~above & fullRow));
+    return features;
+}
+
+static void EvaluateScalar(const BoardBatch& batch, BatchFeatures& features)
+{
+    const uint16_t* rows[defNumRows];
+    for (int r = 0; r < defNumRows; r++)
+    {
+        rows[r] = batch.rows[r];
+    }
+    for (int board = 0; board < batch.count; board++)
+    {
+        BoardFeatures result = EvaluateRows(rows, board);
+        features.aggregateHeight[board] = (uint16_t)result.aggregateHeight;
+        features.maxHeight[board] = (uint16_t)result.maxHeight;
+        features.holes[board] = (uint16_t)result.holes;
+        features.bumpiness[board] = (uint16_t)result.bumpiness;
+        features.rowTransitions[board] = (uint16_t)result.rowTransitions;
+        features.columnTransitions[board] = (uint16_t)result.columnTransitions;
+        features.wells[board] = (uint16_t)result.wells;
+    }
+}
+
+#ifdef TETRIS_FEATURES_X86
+
+// Per 16-bit lane popcount: a nibble lookup with pshufb, then the two byte counts added
+TETRIS_TARGET("sse4.1") static inline __m128i Popcount16(__m128i v)
+{
+    const __m128i lookup = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m128i nibbles = _mm_set1_epi8(0x0F);
+    __m128i low = _mm_shuffle_epi8(lookup, _mm_and_si128(v, nibbles));
+    __m128i high = _mm_shuffle_epi8(lookup, _mm_and_si128(_mm_srli_epi16(v, 4), nibbles));
+    __m128i bytes = _mm_add_epi8(low, high);
+    return _mm_add_epi16(_mm_and_si128(bytes, _mm_set1_epi16(0x00FF)), _mm_srli_epi16(bytes, 8));
+}
+
+TETRIS_TARGET("sse4.1") static void EvaluateSSE4(const BoardBatch& batch, BatchFeatures& features)
+{
+    const __m128i full = _mm_set1_epi16((short)fullRow);
+    const __m128i pairs = _mm_set1_epi16((short)columnPairs);
+    const __m128i walls = _mm_set1_epi16((short)(leftWall | rightWall));
+    const __m128i boundaries = _mm_set1_epi16((short)wallBoundaries);
+    const __m128i left = _mm_set1_epi16((short)leftWall);
+    const __m128i right = _mm_set1_epi16((short)lastColumn);
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i zero = _mm_setzero_si128();
+
+    for (int base = 0; base < batch.count; base += 8)
+    {
+        __m128i covered = zero;
+        __m128i above = zero;
+        __m128i aggregateHeight = zero;
+        __m128i maxHeight = zero;
+        __m128i holes = zero;
+        __m128i bumpiness = zero;
+        __m128i rowTransitions = zero;
+        __m128i columnTransitions = zero;
+        __m128i wells = zero;
+        for (int r = 0; r < defNumRows; r++)
+        {
+            __m128i row = _mm_loadu_si128((const __m128i*)&batch.rows[r][base]);
+            covered = _mm_or_si128(covered, row);
+            aggregateHeight = _mm_add_epi16(aggregateHeight, Popcount16(covered));
+            maxHeight = _mm_add_epi16(maxHeight, _mm_add_epi16(one, _mm_cmpeq_epi16(covered, zero)));
+            holes = _mm_add_epi16(holes, Popcount16(_mm_andnot_si128(row, covered)));
+            __m128i steps = _mm_xor_si128(covered, _mm_srli_epi16(covered, 1));
+            bumpiness = _mm_add_epi16(bumpiness, Popcount16(_mm_and_si128(steps, pairs)));
+            __m128i walled = _mm_or_si128(_mm_slli_epi16(row, 1), walls);
+            __m128i changes = _mm_xor_si128(walled, _mm_srli_epi16(walled, 1));
+            rowTransitions = _mm_add_epi16(rowTransitions, Popcount16(_mm_and_si128(changes, boundaries)));
+            columnTransitions = _mm_add_epi16(columnTransitions, Popcount16(_mm_xor_si128(row, above)));
+            __m128i sides = _mm_and_si128(_mm_or_si128(_mm_slli_epi16(row, 1), left), _mm_or_si128(_mm_srli_epi16(row, 1), right));
+            wells = _mm_add_epi16(wells, Popcount16(_mm_andnot_si128(covered, _mm_and_si128(sides, full))));
+            above = row;
+        }
+        columnTransitions = _mm_add_epi16(columnTransitions, Popcount16(_mm_andnot_si128(above, full)));
+
+        _mm_storeu_si128((__m128i*)&features.aggregateHeight[base], aggregateHeight);
+        _mm_storeu_si128((__m128i*)&features.maxHeight[base], maxHeight);
+        _mm_storeu_si128((__m128i*)&features.holes[base], holes);
+        _mm_storeu_si128((__m128i*)&features.bumpiness[base], bumpiness);
+        _mm_storeu_si128((__m128i*)&features.rowTransitions[base], rowTransitions);
+        _mm_storeu_si128((__m128i*)&features.columnTransitions[base], columnTransitions);
+        _mm_storeu_si128((__m128i*)&features.wells[base], wells);
+    }
+}
+
+TETRIS_TARGET("avx2") static inline __m256i Popcount16(__m256i v)
+{
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibbles = _mm256_set1_epi8(0x0F);
+    __m256i low = _mm256_shuffle_epi8(lookup, _mm256_and_si256(v, nibbles));
+    __m256i high = _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibbles));
+    __m256i bytes = _mm256_add_epi8(low, high);
+    return _mm256_add_epi16(_mm256_and_si256(bytes, _mm256_set1_epi16(0x00FF)), _mm256_srli_epi16(bytes, 8));
+}
+
+TETRIS_TARGET("avx2") static void EvaluateAVX2(const BoardBatch& batch, BatchFeatures& features)
+{
+    const __m256i full = _mm256_set1_epi16((short)fullRow);
+    const __m256i pairs = _mm256_set1_epi16((short)columnPairs);
+    const __m256i walls = _mm256_set1_epi16((short)(leftWall | rightWall));
+    const __m256i boundaries = _mm256_set1_epi16((short)wallBoundaries);
+    const __m256i left = _mm256_set1_epi16((short)leftWall);
+    const __m256i right = _mm256_set1_epi16((short)lastColumn);
+    const __m256i one = _mm256_set1_epi16(1);
+    const __m256i zero = _mm256_setzero_si256();
+
+    for (int base = 0; base < batch.count; base += 16)
+    {
+        __m256i covered = zero;
+        __m256i above = zero;
+        __m256i aggregateHeight = zero;
+        __m256i maxHeight = zero;
+        __m256i holes = zero;
+        __m256i bumpiness = zero;
+        __m256i rowTransitions = zero;
+        __m256i columnTransitions = zero;
+        __m256i wells = zero;
+        for (int r = 0; r < defNumRows; r++)
+        {
+            __m256i row = _mm256_loadu_si256((const __m256i*)&batch.rows[r][base]);
+            covered = _mm256_or_si256(covered, row);
+            aggregateHeight = _mm256_add_epi16(aggregateHeight, Popcount16(covered));
+            maxHeight = _mm256_add_epi16(maxHeight, _mm256_add_epi16(one, _mm256_cmpeq_epi16(covered, zero)));
+            holes = _mm256_add_epi16(holes, Popcount16(_mm256_andnot_si256(row, covered)));
+            __m256i steps = _mm256_xor_si256(covered, _mm256_srli_epi16(covered, 1));
+            bumpiness = _mm256_add_epi16(bumpiness, Popcount16(_mm256_and_si256(steps, pairs)));
+            __m256i walled = _mm256_or_si256(_mm256_slli_epi16(row, 1), walls);
+            __m256i changes = _mm256_xor_si256(walled, _mm256_srli_epi16(walled, 1));
+            rowTransitions = _mm256_add_epi16(rowTransitions, Popcount16(_mm256_and_si256(changes, boundaries)));
+            columnTransitions = _mm256_add_epi16(columnTransitions, Popcount16(_mm256_xor_si256(row, above)));
+            __m256i sides = _mm256_and_si256(_mm256_or_si256(_mm256_slli_epi16(row, 1), left),
+                                             _mm256_or_si256(_mm256_srli_epi16(row, 1), right));
+            wells = _mm256_add_epi16(wells, Popcount16(_mm256_andnot_si256(covered, _mm256_and_si256(sides, full))));
+            above = row;
+        }
+        columnTransitions = _mm256_add_epi16(columnTransitions, Popcount16(_mm256_andnot_si256(above, full)));
+
+        _mm256_storeu_si256((__m256i*)&features.aggregateHeight[base], aggregateHeight);
+        _mm256_storeu_si256((__m256i*)&features.maxHeight[base], maxHeight);
+        _mm256_storeu_si256((__m256i*)&features.holes[base], holes);
+        _mm256_storeu_si256((__m256i*)&features.bumpiness[base], bumpiness);
+        _mm256_storeu_si256((__m256i*)&features.rowTransitions[base], rowTransitions);
+        _mm256_storeu_si256((__m256i*)&features.columnTransitions[base], columnTransitions);
+        _mm256_storeu_si256((__m256i*)&features.wells[base], wells);
+    }
+}
+
+static bool CpuSupports(FeatureKernel kernel)
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool sse41 = (info[2] & (1 << 19)) != 0;
+    bool osSavesAvx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+    bool avx2 = false;
+    if (maxLeaf >= 7 && osSavesAvx)
+    {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+    return kernel == KernelSSE4 ? sse41 : avx2;
+#else
+    return kernel == KernelSSE4 ? __builtin_cpu_supports("sse4.1") : __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+bool IsFeatureKernelSupported(FeatureKernel kernel)
+{
+    if (kernel == KernelScalar)
+    {
+        return true;
+    }
+#ifdef TETRIS_FEATURES_X86
+    return (kernel == KernelSSE4 || kernel == KernelAVX2) && CpuSupports(kernel);
+#else
+    return false;
+#endif
+}
+
+FeatureKernel GetBestFeatureKernel()
+{
+    // Looked up once, the CPU does not change while running
+    static const FeatureKernel best = IsFeatureKernelSupported(KernelAVX2) ? KernelAVX2 :
+                                      IsFeatureKernelSupported(KernelSSE4) ? KernelSSE4 : KernelScalar;
+    return best;
+}
+
+const char* GetFeatureKernelName(FeatureKernel kernel)
+{
+    static const char* const names[numFeatureKernels] = {"scalar", "sse4.1", "avx2"};
+    return kernel >= 0 && kernel < numFeatureKernels ? names[kernel] : "unknown";
+}
+
+void EvaluateBatch(const BoardBatch& batch, BatchFeatures& features)
+{
+    EvaluateBatch(batch, features, GetBestFeatureKernel());
+}
+
+void EvaluateBatch(const BoardBatch& batch, BatchFeatures& features, FeatureKernel kernel)
+{
+    // An unsupported kernel falls back to the scalar one rather than faulting
+    if (IsFeatureKernelSupported(kernel) == false)
+    {
+        kernel = KernelScalar;
+    }
+    switch (kernel)
+    {
+#ifdef TETRIS_FEATURES_X86
+    case KernelSSE4:
+        EvaluateSSE4(batch, features);
+        break;
+    case KernelAVX2:
+        EvaluateAVX2(batch, features);
+        break;
+#endif
+    default:
+        EvaluateScalar(batch, features);
+        break;
+    }
+}
+
+BoardFeatures GetBoardFeatures(const Grid& grid)
+{
+    const uint16_t* rows[defNumRows];
+    const Grid::RowMask* masks = grid.GetRowMasks();
+    for (int r = 0; r < defNumRows; r++)
+    {
+        rows[r] = &masks[r];
+    }
+    return EvaluateRows(rows, 0);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+#include "grid.h"
+
+// Board features a placement is judged by, all counted over the whole board
+struct BoardFeatures
+{
+    int aggregateHeight;   // sum of the column heights
+    int maxHeight;         // height of the tallest column
+    int holes;             // empty cells with a filled cell somewhere above them
+    int bumpiness;         // sum of the height differences between neighbouring columns
+    int rowTransitions;    // filled/empty changes along each row, the walls count as filled
+    int columnTransitions; // filled/empty changes down each column, the floor counts as filled
+    int wells;             // open empty cells with a filled cell or wall on both sides
+};
+
+const int boardBatchSize = 64;
+
+static_assert(std::is_same<Grid::RowMask, uint16_t>::value, "the feature kernels work on 16-bit rows");
+
+// Candidate boards in structure-of-arrays layout: rows[r][b] is row r of board b,
+// so one vector load reads the same row of many boards
+struct BoardBatch
+{
+    uint16_t rows[defNumRows][boardBatchSize];
+    int count;
+
+    BoardBatch();
+    void Clear();
+    int Add(const Grid& grid);
+};
+
+struct BatchFeatures
+{
+    uint16_t aggregateHeight[boardBatchSize];
+    uint16_t maxHeight[boardBatchSize];
+    uint16_t holes[boardBatchSize];
+    uint16_t bumpiness[boardBatchSize];
+    uint16_t rowTransitions[boardBatchSize];
+    uint16_t columnTransitions[boardBatchSize];
+    uint16_t wells[boardBatchSize];
+
+    BoardFeatures Get(int board) const;
+};
+
+// The SIMD kernels give the same counts as the scalar one, they only differ in
+// how many boards they take at once (8 for SSE4.1, 16 for AVX2)
+enum FeatureKernel
+{
+    KernelScalar,
+    KernelSSE4,
+    KernelAVX2,
+    numFeatureKernels,
+};
+
+bool IsFeatureKernelSupported(FeatureKernel kernel);
+FeatureKernel GetBestFeatureKernel();
+const char* GetFeatureKernelName(FeatureKernel kernel);
+
+void EvaluateBatch(const BoardBatch& batch, BatchFeatures& features);
+void EvaluateBatch(const BoardBatch& batch, BatchFeatures& features, FeatureKernel kernel);
+BoardFeatures GetBoardFeatures(const Grid& grid);
@@ -0,0 +1,692 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include "bot.h"
+
+Bot::Bot()
+{
+    weights = defaultBotWeights;
+    lookahead = false;
+    placementsEvaluated = 0;
+    beamWidth = defaultBeamWidth;
+    beamDepth = 0;
+    stats = {0, 0, 0.0, 0.0, 0, 0.0, 0, 0, 0, 0, 0};
+    rolloutDepth = 0;
+    rolloutCount = defaultRolloutCount;
+    rolloutBudget = 0.0;
+    rolloutNextId = 0;
+    rolloutSeed = 0;
+    Reset();
+}
+
+Bot::Bot(const BotWeights& weights)
+{
+    this->weights = weights;
+    lookahead = false;
+    placementsEvaluated = 0;
+    beamWidth = defaultBeamWidth;
+    beamDepth = 0;
+    stats = {0, 0, 0.0, 0.0, 0, 0.0, 0, 0, 0, 0, 0};
+    rolloutDepth = 0;
+    rolloutCount = defaultRolloutCount;
+    rolloutBudget = 0.0;
+    rolloutNextId = 0;
+    rolloutSeed = 0;
+    Reset();
+}
+
+void Bot::Reset()
+{
+    // Forget the plan, the next call to NextInput searches again
+    planned = false;
+    plannedBagPosition = 0;
+    plannedId = 0;
+    target = {false, 0, 0, 0.0};
+}
+
+void Bot::SetWeights(const BotWeights& weights)
+{
+    this->weights = weights;
+    Reset();
+}
+
+const BotWeights& Bot::GetWeights() const
+{
+    return weights;
+}
+
+void Bot::SetLookahead(bool enabled)
+{
+    lookahead = enabled;
+    Reset();
+}
+
+bool Bot::GetLookahead() const
+{
+    return lookahead;
+}
+
+void Bot::SetBeam(int width, int depth)
+{
+    // A depth of 0 turns beam search off
+    beamWidth = std::max(width, 1);
+    beamDepth = std::min(std::max(depth, 0), maxBeamDepth);
+    Reset();
+}
+
+int Bot::GetBeamWidth() const
+{
+    return beamWidth;
+}
+
+int Bot::GetBeamDepth() const
+{
+    return beamDepth;
+}
+
+void Bot::SetRollouts(int depth, int count, double budgetSeconds, int numThreads)
+{
+    // A depth of 0 turns rollouts off, the threads are only started for them
+    rolloutDepth = std::max(depth, 0);
+    rolloutCount = std::max(count, 1);
+    rolloutBudget = std::max(budgetSeconds, 0.0);
+    if (rolloutDepth > 0 && (rolloutPool == nullptr || (numThreads > 0 && numThreads != rolloutPool->GetNumThreads())))
+    {
+        rolloutPool.reset(new ThreadPool(numThreads));
+        rolloutWorkers.clear();
+        for (int i = 0; i < rolloutPool->GetNumThreads(); i++)
+        {
+            rolloutWorkers.emplace_back(new RolloutWorker);
+        }
+    }
+    Reset();
+}
+
+int Bot::GetRolloutDepth() const
+{
+    return rolloutDepth;
+}
+
+int Bot::GetRolloutCount() const
+{
+    return rolloutCount;
+}
+
+int Bot::GetRolloutThreads() const
+{
+    return rolloutPool ? rolloutPool->GetNumThreads() : 0;
+}
+
+void Bot::SetFeatureTable(size_t bytes)
+{
+    featureTable.Resize(bytes);
+}
+
+size_t Bot::GetFeatureTableBytes() const
+{
+    return featureTable.GetMemoryUsage();
+}
+
+int64_t Bot::GetPlacementsEvaluated() const
+{
+    return placementsEvaluated;
+}
+
+const BotSearchStats& Bot::GetSearchStats() const
+{
+    return stats;
+}
+
+void Bot::RecordSearch(int64_t nodes, double seconds)
+{
+    stats.searches++;
+    stats.nodes += nodes;
+    stats.seconds += seconds;
+    stats.maxSeconds = std::max(stats.maxSeconds, seconds);
+    stats.lastNodes = nodes;
+    stats.lastSeconds = seconds;
+    stats.arenaBytes = beamNodes.GetMemoryUsage();
+}
+
+EngineInput Bot::NextInput(const Engine& engine)
+{
+    EngineInput input = {false, false, false, false, false};
+    if (engine.IsGameOver())
+    {
+        return input;
+    }
+
+    // Every spawn draws from the bag, so a new bag position means a new block to plan for
+    const Block& block = engine.GetCurrentBlock();
+    int bagPosition = engine.GetBag().GetBagPosition();
+    if (planned == false || bagPosition != plannedBagPosition || block.id != plannedId)
+    {
+        if (rolloutDepth > 0)
+        {
+            target = FindPlacementByRollouts(engine.GetGrid(), block, engine.GetNextBlock().id);
+        }
+        else if (beamDepth > 0)
+        {
+            // The next block, then the bag for as far as the beam looks
+            int preview[maxBeamDepth];
+            preview[0] = engine.GetNextBlock().id;
+            for (int i = 1; i + 1 < beamDepth; i++)
+            {
+                preview[i] = engine.GetBag().Peek(i - 1);
+            }
+            target = FindPlacement(engine.GetGrid(), block, preview, beamDepth - 1);
+        }
+        else
+        {
+            target = FindPlacement(engine.GetGrid(), block, lookahead ? engine.GetNextBlock().id : 0);
+        }
+        planned = true;
+        plannedBagPosition = bagPosition;
+        plannedId = block.id;
+    }
+
+    bool turn = target.found && block.GetRotationState() != target.rotation;
+    int step = target.found ? (target.column > block.GetColumnOffset()) - (target.column < block.GetColumnOffset()) : 0;
+    if (turn == false && step == 0)
+    {
+        input.hardDrop = true;
+        return input;
+    }
+
+    // Gravity or a kick can leave the block where the path is blocked, it is
+    // dropped where it is rather than held until the lock delay runs out
+    const Grid& grid = engine.GetGrid();
+    Block moved = block;
+    moved.Move(0, step);
+    bool stepBlocked = step != 0 && (grid.IsBlockOutside(moved) || grid.BlockFits(moved) == false);
+    bool turnBlocked = false;
+    if (turn)
+    {
+        const KickTable& kicks = *blockShapes[block.id].kicks;
+        Block turned = block;
+        turned.Rotate();
+        turnBlocked = grid.FindFittingOffset(turned, kicks.offsets[block.GetRotationState()], kicks.numKicks) < 0;
+    }
+    if (turnBlocked || (stepBlocked && turn == false))
+    {
+        input.hardDrop = true;
+        return input;
+    }
+
+    input.rotate = turn;
+    input.left = step < 0 && stepBlocked == false;
+    input.right = step > 0 && stepBlocked == false;
+    return input;
+}
+
+BotPlacement Bot::FindPlacement(const Grid& grid, const Block& block, int nextId)
+{
+    // With lookahead every pair of placements is scored on the board after both.
+    // If the next block cannot spawn after any of them the search falls back to
+    // the current block alone.
+    auto start = std::chrono::steady_clock::now();
+    int64_t before = placementsEvaluated;
+    BotPlacement best = Search(grid, block, nextId, 0);
+    if (best.found == false && nextId != 0)
+    {
+        best = Search(grid, block, 0, 0);
+    }
+    RecordSearch(placementsEvaluated - before, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    return best;
+}
+
+BotPlacement Bot::FindPlacement(const Grid& grid, const Block& block, const int* preview, int previewLength)
+{
+    // Beam search over block and the previewLength ids after it, or as many of
+    // them as the beam depth allows
+    auto start = std::chrono::steady_clock::now();
+    int64_t before = placementsEvaluated;
+    BotPlacement best = BeamSearch(grid, block, preview, previewLength);
+    RecordSearch(placementsEvaluated - before, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    return best;
+}
+
+BotPlacement Bot::FindPlacementByRollouts(const Grid& grid, const Block& block, int nextId)
+{
+    // Rollouts were never set, so there are no threads, the plain search stands in
+    if (rolloutPool == nullptr)
+    {
+        return FindPlacement(grid, block, 0);
+    }
+    auto start = std::chrono::steady_clock::now();
+    Block drops[numRotations * defNumCols];
+    int numDrops = FindDrops(grid, block, drops);
+    rolloutStarts.resize(numDrops);
+    rolloutCleared.resize(numDrops);
+    for (int i = 0; i < numDrops; i++)
+    {
+        rolloutStarts[i] = grid;
+        rolloutStarts[i].PlaceBlock(drops[i]);
+        rolloutCleared[i] = rolloutStarts[i].ClearFullRows();
+    }
+    for (const std::unique_ptr<RolloutWorker>& worker : rolloutWorkers)
+    {
+        worker->placements = 0;
+        worker->tableProbes = 0;
+        worker->tableHits = 0;
+    }
+    int numTasks = numDrops * rolloutCount;
+    rolloutScores.resize(numTasks);
+    rolloutPlayed.assign(numTasks, 0);
+
+    // The search count seeds the pieces, so a search without a time budget gives
+    // the same answer on any number of threads
+    rolloutNextId = nextId;
+    rolloutSeed = (uint64_t)stats.searches << 32;
+    rolloutDeadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(rolloutBudget));
+    rolloutPool->Run(numTasks, [this](int task, int worker) { RunRollout(task, worker); });
+
+    // Summed in task order, not by thread, for the same reason
+    BotPlacement best = {false, 0, 0, 0.0};
+    int64_t placements = numDrops;
+    for (int i = 0; i < numDrops; i++)
+    {
+        double sum = 0.0;
+        int count = 0;
+        for (int task = i; task < numTasks; task += numDrops)
+        {
+            sum += rolloutPlayed[task] ? rolloutScores[task] : 0.0;
+            count += rolloutPlayed[task];
+        }
+        stats.rollouts += count;
+        double score = sum / count;
+        if (best.found == false || score > best.score)
+        {
+            best = {true, drops[i].GetRotationState(), drops[i].GetColumnOffset(), score};
+        }
+    }
+    for (const std::unique_ptr<RolloutWorker>& worker : rolloutWorkers)
+    {
+        placements += worker->placements;
+        stats.tableProbes += worker->tableProbes;
+        stats.tableHits += worker->tableHits;
+    }
+    placementsEvaluated += placements;
+    RecordSearch(placements, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    return best;
+}
+
+void Bot::RunRollout(int task, int worker)
+{
+    // Tasks go round by round, round k holds rollout k of every placement
+    int numStarts = (int)rolloutStarts.size();
+    int round = task / numStarts;
+    int start = task % numStarts;
+    if (round > 0 && rolloutBudget > 0.0 && std::chrono::steady_clock::now() >= rolloutDeadline)
+    {
+        return;
+    }
+    rolloutScores[task] = Rollout(*rolloutWorkers[worker], rolloutStarts[start], rolloutCleared[start], rolloutSeed | (uint32_t)round);
+    rolloutPlayed[task] = 1;
+}
+
+static uint64_t NextRolloutRandom(uint64_t& state)
+{
+    // splitmix64
+    state += 0x9E3779B97F4A7C15ull;
+    uint64_t z = state;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+double Bot::Rollout(RolloutWorker& worker, const Grid& grid, int clearedRows, uint64_t seed)
+{
+    // A rollout that tops out scores below any board it could have ended on
+    const double toppedOutScore = -1000.0;
+
+    Grid board = grid;
+    PieceBag bag(seed);
+    uint64_t random = ~seed;
+    for (int step = 0; step < rolloutDepth; step++)
+    {
+        Block piece(step == 0 && rolloutNextId != 0 ? rolloutNextId : bag.Next());
+        Block drops[numRotations * defNumCols];
+        int numDrops = FindDrops(board, piece, drops);
+        if (numDrops == 0)
+        {
+            return toppedOutScore;
+        }
+
+        int pick = 0;
+        if (NextRolloutRandom(random) % 8 == 0)
+        {
+            pick = (int)(NextRolloutRandom(random) % numDrops);
+        }
+        else
+        {
+            // Scored like a search without lookahead, ties go to the first drop. Only
+            // the boards the feature table does not have go in the batch.
+            int cleared[numRotations * defNumCols];
+            uint64_t keys[numRotations * defNumCols];
+            BoardFeatures features[numRotations * defNumCols];
+            int batched[numRotations * defNumCols];
+            worker.batch.Clear();
+            for (int i = 0; i < numDrops; i++)
+            {
+                Grid after = board;
+                after.PlaceBlock(drops[i]);
+                cleared[i] = after.ClearFullRows();
+                keys[i] = after.GetHash() ^ zobristKeys.depths[0];
+                if (ProbeFeatures(keys[i], features[i], worker.tableProbes, worker.tableHits) == false)
+                {
+                    batched[worker.batch.Add(after)] = i;
+                }
+            }
+            if (worker.batch.count > 0)
+            {
+                EvaluateBatch(worker.batch, worker.features);
+                for (int board = 0; board < worker.batch.count; board++)
+                {
+                    int i = batched[board];
+                    features[i] = worker.features.Get(board);
+                    StoreFeatures(keys[i], features[i]);
+                }
+            }
+            double best = 0.0;
+            for (int i = 0; i < numDrops; i++)
+            {
+                double score = Score(features[i], cleared[i]);
+                if (i == 0 || score > best)
+                {
+                    best = score;
+                    pick = i;
+                }
+            }
+            worker.placements += numDrops;
+        }
+        board.PlaceBlock(drops[pick]);
+        clearedRows += board.ClearFullRows();
+    }
+    return Score(GetBoardFeatures(board), clearedRows);
+}
+
+int Bot::FindDrops(const Grid& grid, const Block& block, Block* drops)
+{
+    // Every distinct rotation at every column it fits in at the block's row,
+    // dropped straight down. Returns how many were written to drops.
+    int numDrops = 0;
+    const BlockRotation* tried[numRotations];
+    Block rotated = block;
+    for (int turn = 0; turn < numRotations; turn++, rotated.Rotate())
+    {
+        // O looks the same in every state, a repeated shape lands in the same places
+        const BlockRotation& shape = rotated.GetRotation();
+        tried[turn] = &shape;
+        bool repeated = false;
+        for (int i = 0; i < turn; i++)
+        {
+            repeated = repeated || std::equal(shape.rowMasks, shape.rowMasks + 4, tried[i]->rowMasks);
+        }
+        if (repeated)
+        {
+            continue;
+        }
+
+        for (int column = -shape.minColumn; column + shape.maxColumn < Grid::GetNumCols(); column++)
+        {
+            Block candidate = rotated;
+            candidate.Move(0, column - rotated.GetColumnOffset());
+            if (grid.IsBlockOutside(candidate) || grid.BlockFits(candidate) == false)
+            {
+                continue;
+            }
+            candidate.Move(grid.DropDistance(candidate), 0);
+            drops[numDrops++] = candidate;
+        }
+    }
+    return numDrops;
+}
+
+BotPlacement Bot::Search(const Grid& grid, const Block& block, int nextId, int clearedRows)
+{
+    // Without lookahead the boards are only scored, they are collected into the
+    // batch and their features counted together once every candidate is known
+    BotPlacement best = {false, 0, 0, 0.0};
+    BotPlacement candidates[boardBatchSize];
+    int candidateRows[boardBatchSize];
+    batch.Clear();
+
+    Block drops[numRotations * defNumCols];
+    int numDrops = FindDrops(grid, block, drops);
+    for (int i = 0; i < numDrops; i++)
+    {
+        const Block& candidate = drops[i];
+        Grid after = grid;
+        after.PlaceBlock(candidate);
+        int cleared = clearedRows + after.ClearFullRows();
+        placementsEvaluated++;
+
+        if (nextId == 0)
+        {
+            if (batch.count == boardBatchSize)
+            {
+                best = ScoreBatch(candidates, candidateRows, best);
+                batch.Clear();
+            }
+            int board = batch.Add(after);
+            candidates[board] = {true, candidate.GetRotationState(), candidate.GetColumnOffset(), 0.0};
+            candidateRows[board] = cleared;
+            continue;
+        }
+
+        BotPlacement next = Search(after, Block(nextId), 0, cleared);
+        if (next.found && (best.found == false || next.score > best.score))
+        {
+            best = {true, candidate.GetRotationState(), candidate.GetColumnOffset(), next.score};
+        }
+    }
+    return nextId == 0 ? ScoreBatch(candidates, candidateRows, best) : best;
+}
+
+BotPlacement Bot::BeamSearch(const Grid& grid, const Block& block, const int* preview, int previewLength)
+{
+    beamNodes.Reset();
+    beam.clear();
+    int levels = std::min(std::max(beamDepth, 1), 1 + previewLength);
+
+    BeamNode* root = beamNodes.Allocate();
+    *root = BeamNode{grid, 0, 0, 0, 0.0, 0};
+    beam.push_back(root);
+    int order = 1;
+
+    for (int level = 0; level < levels; level++)
+    {
+        Block piece = level == 0 ? block : Block(preview[level - 1]);
+        children.clear();
+        scoring.clear();
+        batch.Clear();
+        size_t indexSize = 16;
+        while (indexSize < beam.size() * numRotations * defNumCols * 2)
+        {
+            indexSize *= 2;
+        }
+        childIndex.assign(indexSize, nullptr);
+        BeamNode* spare = nullptr;
+        for (const BeamNode* node : beam)
+        {
+            Block drops[numRotations * defNumCols];
+            int numDrops = FindDrops(node->grid, piece, drops);
+            for (int i = 0; i < numDrops; i++)
+            {
+                BeamNode* child = spare != nullptr ? spare : beamNodes.Allocate();
+                spare = nullptr;
+                child->grid = node->grid;
+                child->grid.PlaceBlock(drops[i]);
+                child->clearedRows = node->clearedRows + child->grid.ClearFullRows();
+                child->rotation = level == 0 ? drops[i].GetRotationState() : node->rotation;
+                child->column = level == 0 ? drops[i].GetColumnOffset() : node->column;
+                child->order = order++;
+
+                // The same board reached again only differs in the rows cleared on
+                // the way, the one that scores higher for them stays and the other
+                // is never scored. On a tie the earlier one stays.
+                BeamNode*& same = FindChild(child->grid);
+                if (same != nullptr)
+                {
+                    double gain = weights.completeLines * (child->clearedRows - same->clearedRows);
+                    if (gain > 0)
+                    {
+                        same->score += gain; // set again if it is still waiting in the batch
+                        same->clearedRows = child->clearedRows;
+                        same->rotation = child->rotation;
+                        same->column = child->column;
+                        same->order = child->order;
+                    }
+                    spare = child;
+                    stats.duplicates++;
+                    continue;
+                }
+                same = child;
+                children.push_back(child);
+                BoardFeatures features;
+                if (ProbeFeatures(child->grid.GetHash() ^ zobristKeys.depths[0], features, stats.tableProbes, stats.tableHits))
+                {
+                    child->score = Score(features, child->clearedRows);
+                    continue;
+                }
+                scoring.push_back(child);
+                batch.Add(child->grid);
+                if (batch.count == boardBatchSize)
+                {
+                    ScoreChildren();
+                }
+            }
+        }
+        ScoreChildren();
+        placementsEvaluated += (int64_t)children.size();
+
+        // When every board of a level tops out, the beam of the level before stands
+        if (children.empty())
+        {
+            break;
+        }
+        size_t keep = std::min(children.size(), (size_t)beamWidth);
+        std::partial_sort(children.begin(), children.begin() + keep, children.end(), [](const BeamNode* a, const BeamNode* b)
+        {
+            return a->score > b->score || (a->score == b->score && a->order < b->order);
+        });
+        beam.assign(children.begin(), children.begin() + keep);
+    }
+
+    const BeamNode* best = beam.front();
+    if (best == root)
+    {
+        return BotPlacement{false, 0, 0, 0.0};
+    }
+    return BotPlacement{true, best->rotation, best->column, best->score};
+}
+
+Bot::BeamNode*& Bot::FindChild(const Grid& grid)
+{
+    // The slot of the child with this board, or the empty slot it would go in.
+    // Equal hashes are only a hint, the rows are compared so that two boards
+    // whose hashes collide stay apart.
+    uint64_t hash = grid.GetHash();
+    size_t mask = childIndex.size() - 1;
+    size_t slot = hash & mask;
+    while (childIndex[slot] != nullptr)
+    {
+        const Grid& other = childIndex[slot]->grid;
+        if (other.GetHash() == hash &&
+            memcmp(other.GetRowMasks(), grid.GetRowMasks(), Grid::GetNumRows() * sizeof(*grid.GetRowMasks())) == 0)
+        {
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return childIndex[slot];
+}
+
+void Bot::ScoreChildren()
+{
+    // Scores the children waiting in the batch and keeps their features in the table
+    if (batch.count == 0)
+    {
+        return;
+    }
+    EvaluateBatch(batch, batchFeatures);
+    for (int board = 0; board < batch.count; board++)
+    {
+        BeamNode* child = scoring[board];
+        BoardFeatures features = batchFeatures.Get(board);
+        child->score = Score(features, child->clearedRows);
+        StoreFeatures(child->grid.GetHash() ^ zobristKeys.depths[0], features);
+    }
+    batch.Clear();
+    scoring.clear();
+}
+
+BotPlacement Bot::ScoreBatch(const BotPlacement* candidates, const int* clearedRows, BotPlacement best)
+{
+    // Boards are scored in the order they were added, so ties go to the earlier one
+    EvaluateBatch(batch, batchFeatures);
+    for (int board = 0; board < batch.count; board++)
+    {
+        double score = Score(batchFeatures.Get(board), clearedRows[board]);
+        if (best.found == false || score > best.score)
+        {
+            best = candidates[board];
+            best.score = score;
+        }
+    }
+    return best;
+}
+
+double Bot::Evaluate(const Grid& grid, int clearedRows) const
+{
+    return Score(GetBoardFeatures(grid), clearedRows);
+}
+
+double Bot::Score(const BoardFeatures& features, int clearedRows) const
+{
+    return weights.aggregateHeight * features.aggregateHeight + weights.completeLines * clearedRows +
+           weights.holes * features.holes + weights.bumpiness * features.bumpiness +
+           weights.rowTransitions * features.rowTransitions +
+           weights.columnTransitions * features.columnTransitions + weights.wells * features.wells;
+}
+
+bool Bot::ProbeFeatures(uint64_t key, BoardFeatures& features, int64_t& probes, int64_t& hits) const
+{
+    // Callers key a board by its hash and the depth 0 key, a board with no pieces
+    // left to place, so even the empty board has a key an empty slot cannot match
+    if (featureTable.GetNumSlots() == 0)
+    {
+        return false;
+    }
+    TableData data;
+    probes++;
+    if (featureTable.Probe(key, data) == false)
+    {
+        return false;
+    }
+    hits++;
+    features.aggregateHeight = (int)(data.value & 0xFFFF);
+    features.maxHeight = (int)((data.value >> 16) & 0xFFFF);
+    features.holes = (int)((data.value >> 32) & 0xFFFF);
+    features.bumpiness = (int)(data.value >> 48);
+    features.rowTransitions = (int)(data.extra & 0xFFFF);
+    features.columnTransitions = (int)((data.extra >> 16) & 0xFFFF);
+    features.wells = (int)((data.extra >> 32) & 0xFFFF);
+    return true;
+}
+
+void Bot::StoreFeatures(uint64_t key, const BoardFeatures& features)
+{
+    // Every count fits in 16 bits, like the batch kernels keep them
+    if (featureTable.GetNumSlots() == 0)
+    {
+        return;
+    }
+    TableData data;
+    data.value = (uint64_t)features.aggregateHeight | (uint64_t)features.maxHeight << 16 |
+                 (uint64_t)features.holes << 32 | (uint64_t)features.bumpiness << 48;
+    data.extra = (uint64_t)features.rowTransitions | (uint64_t)features.columnTransitions << 16 |
+                 (uint64_t)features.wells << 32;
+    featureTable.Store(key, data);
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "engine.h"
+#include "arena.h"
+#include "board_features.h"
+#include "thread_pool.h"
+#include "transposition.h"
+
+// Weights of the board features a placement is scored by, higher scores are better
+struct BotWeights
+{
+    double aggregateHeight;   // sum of the column heights
+    double completeLines;     // rows cleared by the placement
+    double holes;             // empty cells with a filled cell somewhere above them
+    double bumpiness;         // sum of the height differences between neighbouring columns
+    double rowTransitions;    // filled/empty changes along each row
+    double columnTransitions; // filled/empty changes down each column
+    double wells;             // open empty cells with a filled cell or wall on both sides
+};
+
+// A well known set of weights for the first four features, found by a genetic search
+const BotWeights defaultBotWeights = {-0.510066, 0.760666, -0.35663, -0.184483, 0.0, 0.0, 0.0};
+
+// Where the current block should land, as the rotation state and column offset it lands with
+struct BotPlacement
+{
+    bool found;
+    int rotation;
+    int column;
+    double score;
+};
+
+// Time and size of the searches made so far, placements scored count as nodes
+struct BotSearchStats
+{
+    int64_t searches;
+    int64_t nodes;
+    double seconds;
+    double maxSeconds;  // the slowest single search
+    int64_t lastNodes;
+    double lastSeconds;
+    size_t arenaBytes;  // memory held for beam search nodes
+    int64_t duplicates; // beam boards dropped because a better path reached the same board
+    int64_t rollouts;   // games played forward by rollout searches
+    int64_t tableProbes; // boards looked up in the feature table
+    int64_t tableHits;   // boards whose features came from the table
+};
+
+// Longest piece sequence a beam search looks at: the current block and the preview after it
+const int maxBeamDepth = 16;
+const int defaultBeamWidth = 32;
+
+const int defaultRolloutDepth = 8;
+const int defaultRolloutCount = 64;
+
+// Computer player. For the current block (and optionally the next one) it tries
+// every rotation and column, drops the block straight down onto a copy of the
+// grid, scores the result and then steers towards the best placement with the
+// same EngineInput a player would give, one tick at a time.
+//
+// With a beam depth set it looks further ahead instead: the current block, the
+// next one and as much of the bag as the depth asks for. Each level places the
+// next piece on every board kept from the level before and keeps the beamWidth
+// best scoring boards. The first placement on the path to the best board at the
+// last level is played. Nodes come from an arena emptied at the start of every
+// search. Boards reached along more than one path are kept once per level, so a
+// duplicate never takes the place of a different board in the beam.
+//
+// With rollouts set it plays each placement of the current block forward instead:
+// the next block, then pieces from a bag seeded afresh for every rollout, each
+// placed where the weights score best or, one time in eight, anywhere at random.
+// A placement is worth the average score of the boards its rollouts end on.
+// Rollout k plays the same pieces after every placement, so placements are
+// compared on the same luck. The rollouts are run on a ThreadPool in rounds of
+// one per placement. Once the time budget is spent the rollouts not yet started
+// are skipped, all but the first round, so every placement keeps at least one.
+//
+// With a feature table set, beam and rollout searches keep the features of the
+// boards they score in a TranspositionTable keyed by the board hash, and read
+// them back when the board comes up again: in the next round of rollouts, which
+// all start with the same next block, or in the next move's beam, which goes
+// over most of the boards the last one did. Features rather than scores are
+// kept, so the table gives the same answers with any weights and the search
+// chooses exactly what it would without one.
+class Bot
+{
+public:
+    Bot();
+    explicit Bot(const BotWeights& weights);
+    void Reset();
+    void SetWeights(const BotWeights& weights);
+    const BotWeights& GetWeights() const;
+    void SetLookahead(bool enabled);
+    bool GetLookahead() const;
+    void SetBeam(int width, int depth);
+    int GetBeamWidth() const;
+    int GetBeamDepth() const;
+    void SetRollouts(int depth, int count, double budgetSeconds, int numThreads);
+    int GetRolloutDepth() const;
+    int GetRolloutCount() const;
+    int GetRolloutThreads() const;
+    void SetFeatureTable(size_t bytes); // 0 turns the table off
+    size_t GetFeatureTableBytes() const;
+
+    EngineInput NextInput(const Engine& engine);
+    BotPlacement FindPlacement(const Grid& grid, const Block& block, int nextId);
+    BotPlacement FindPlacement(const Grid& grid, const Block& block, const int* preview, int previewLength);
+    BotPlacement FindPlacementByRollouts(const Grid& grid, const Block& block, int nextId);
+    double Evaluate(const Grid& grid, int clearedRows) const;
+    int64_t GetPlacementsEvaluated() const;
+    const BotSearchStats& GetSearchStats() const;
+
+private:
+    // A board in the beam, with the first placement of the path that led to it
+    struct BeamNode
+    {
+        Grid grid;
+        int clearedRows;
+        int rotation;
+        int column;
+        double score;
+        int order; // creation order, breaks ties between equal scores
+    };
+
+    // What one thread of a rollout search works with
+    struct RolloutWorker
+    {
+        BoardBatch batch;
+        BatchFeatures features;
+        int64_t placements;
+        int64_t tableProbes;
+        int64_t tableHits;
+    };
+
+    static int FindDrops(const Grid& grid, const Block& block, Block* drops);
+    BotPlacement Search(const Grid& grid, const Block& block, int nextId, int clearedRows);
+    BotPlacement BeamSearch(const Grid& grid, const Block& block, const int* preview, int previewLength);
+    void ScoreChildren();
+    BeamNode*& FindChild(const Grid& grid);
+    void RunRollout(int task, int worker);
+    double Rollout(RolloutWorker& worker, const Grid& grid, int clearedRows, uint64_t seed);
+    void RecordSearch(int64_t nodes, double seconds);
+    BotPlacement ScoreBatch(const BotPlacement* candidates, const int* clearedRows, BotPlacement best);
+    double Score(const BoardFeatures& features, int clearedRows) const;
+    bool ProbeFeatures(uint64_t key, BoardFeatures& features, int64_t& probes, int64_t& hits) const;
+    void StoreFeatures(uint64_t key, const BoardFeatures& features);
+
+    BotWeights weights;
+    bool lookahead;
+    int64_t placementsEvaluated;
+
+    // boards of the last block searched, scored together by EvaluateBatch
+    BoardBatch batch;
+    BatchFeatures batchFeatures;
+
+    int beamWidth;
+    int beamDepth;            // 0 when beam search is off
+    Arena<BeamNode> beamNodes;
+    std::vector<BeamNode*> beam;
+    std::vector<BeamNode*> children;
+    std::vector<BeamNode*> scoring;    // children whose boards wait in the batch
+    std::vector<BeamNode*> childIndex; // children by grid hash, open addressing, emptied every level
+    BotSearchStats stats;
+    TranspositionTable featureTable; // empty until SetFeatureTable
+
+    int rolloutDepth;         // 0 when rollouts are off
+    int rolloutCount;         // rollouts per placement when the budget allows
+    double rolloutBudget;     // seconds per search, 0 for no limit
+    std::unique_ptr<ThreadPool> rolloutPool;
+    std::vector<std::unique_ptr<RolloutWorker>> rolloutWorkers;
+
+    // the search the pool is running: each placement's board and rows cleared,
+    // then the score of every rollout and whether it was played, by task
+    std::vector<Grid> rolloutStarts;
+    std::vector<int> rolloutCleared;
+    std::vector<double> rolloutScores;
+    std::vector<uint8_t> rolloutPlayed;
+    int rolloutNextId;
+    uint64_t rolloutSeed;
+    std::chrono::steady_clock::time_point rolloutDeadline;
+
+    // the placement chosen for the block that spawned at plannedBagPosition
+    bool planned;
+    int plannedBagPosition;
+    int plannedId;
+    BotPlacement target;
+};
@@ -0,0 +1,47 @@
+#include "globals.h"
+#include "grid.h"
+#include "block.h"
+
+// Raylib drawing for the engine types, kept out of the engine library so it stays headless
+
+template <int Rows, int Cols>
+void BasicGrid<Rows, Cols>::Draw() const
+{
+    // Draw the grid cells
+    for (int row = 0; row < Rows; row++)
+    {
+        for (int col = 0; col < Cols; col++)
+        {
+            int cellValue = GetCell(row, col);
+            DrawRectangle(col * defCellSize + 11, row * defCellSize + 11, defCellSize - 1, defCellSize - 1, cellColors[cellValue]);
+        }
+    }
+
+    // Draw grid lines
+    Color gridLineColor = {60, 60, 60, 255};
+    int lineThickness = gridThickness;
+
+    // Draw vertical lines
+    for (int col = 0; col <= Cols; col++)
+    {
+        DrawRectangle(col * defCellSize + 10, 11, lineThickness, Rows * defCellSize, gridLineColor);
+    }
+
+    // Draw horizontal lines
+    for (int row = 0; row <= Rows; row++)
+    {
+        DrawRectangle(10, row * defCellSize + 11, Cols * defCellSize, lineThickness, gridLineColor);
+    }
+}
+
+template void BasicGrid<defNumRows, defNumCols>::Draw() const;
+
+void Block::Draw(int offsetX, int offsetY) const
+{
+    BlockCells tiles = GetCellPositions();
+    static const int blockGridPadding = gridThickness+1;
+    for(Position item: tiles)
+    {
+        DrawRectangle(offsetX + item.column * defCellSize + 10 + blockGridPadding, offsetY + item.row * defCellSize + 10 + blockGridPadding, defCellSize - blockGridPadding, defCellSize - blockGridPadding, cellColors[id]);
+    }
+}
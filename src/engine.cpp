@@ -0,0 +1,557 @@
+#include <algorithm>
+#include <cstring>
+#include "engine.h"
+
+Engine::Engine()
+{
+    Reset(0);
+}
+
+void Engine::Reset(uint64_t seed, int gravity)
+{
+    state.grid.Initialize();
+
+    // The same seed always deals the same pieces
+    state.seed = seed;
+    state.bag.Seed(seed);
+    state.currentBlock = GetRandomBlock();
+    state.nextBlock = GetRandomBlock();
+    UpdateGhostPiece();
+
+    state.score = 0;
+    state.currentLevel = startingLevel;
+    state.gameOver = false;
+    state.events = {0, 0};
+    state.tickCount = 0;
+    state.gravityTicks = 0;
+    state.gravity = std::min(std::max(gravity, 0), instantGravity);
+    state.gravityFraction = 0;
+    state.lockBlockTicks = 0;
+    state.lockBlock = false;
+    state.firstDrop = true;
+    state.lockStateMoves = 0;
+    state.inputTicks = inputDelayTicks;
+    state.rotateInputTicks = rotateInputDelayTicks;
+    state.dropAfterSpawnTicks = 0;
+    ApplyInstantGravity();
+}
+
+EngineEvents Engine::Tick(const EngineInput& input)
+{
+    state.events = {0, 0};
+    if (state.gameOver)
+    {
+        return state.events;
+    }
+    state.tickCount++;
+
+    HandleInput(input);
+
+    if (state.gravity > 0)
+    {
+        ApplyFixedGravity();
+    }
+    else
+    {
+        state.gravityTicks++;
+        if (state.gravityTicks >= GetGravityInterval())
+        {
+            state.gravityTicks = 0;
+            MoveBlockDown();
+        }
+    }
+
+    if (state.lockBlock)
+    {
+        state.lockBlockTicks++;
+        if (state.lockBlockTicks > blockLockTicks)
+        {
+            LockBlock();
+        }
+    }
+    return state.events;
+}
+
+EngineEvents Engine::Advance(const EngineInput& input, int64_t maxTicks, int64_t& ticksAdvanced)
+{
+    // Same as calling Tick(input) up to maxTicks times, but the ticks where only
+    // the timers count up are skipped in one step. Stops after the first tick
+    // that raises events so the caller sees them in order.
+    ticksAdvanced = 0;
+    while (ticksAdvanced < maxTicks && state.gameOver == false)
+    {
+        int64_t quietTicks = std::min(GetQuietTicks(input), maxTicks - ticksAdvanced);
+        SkipQuietTicks(quietTicks);
+        ticksAdvanced += quietTicks;
+        if (ticksAdvanced == maxTicks)
+        {
+            break;
+        }
+
+        EngineEvents events = Tick(input);
+        ticksAdvanced++;
+        if (events.flags != 0)
+        {
+            return events;
+        }
+    }
+    return EngineEvents{0, 0};
+}
+
+int64_t Engine::GetQuietTicks(const EngineInput& input) const
+{
+    // Ticks before the next one where a timer fires and something can happen.
+    // A timer that fires once counter + k reaches its threshold leaves k - 1 quiet ticks.
+    int64_t quiet = std::max(GetGravityInterval() - state.gravityTicks - 1, 0);
+    if (state.gravity > 0)
+    {
+        // Fixed gravity does nothing to a landed block until the lock timer runs out
+        bool landed = state.lockBlock && state.lockStateMoves < maxLockStateMoves &&
+                      state.grid.DropDistance(state.currentBlock) == 0;
+        quiet = landed ? INT64_MAX : (gravityUnit - state.gravityFraction - 1) / state.gravity;
+    }
+    if (state.lockBlock)
+    {
+        quiet = std::min<int64_t>(quiet, std::max(blockLockTicks - state.lockBlockTicks, 0));
+    }
+    if (input.left || input.right)
+    {
+        quiet = std::min<int64_t>(quiet, std::max(inputDelayTicks - state.inputTicks - 1, 0));
+    }
+    if (input.rotate)
+    {
+        quiet = std::min<int64_t>(quiet, std::max(rotateInputDelayTicks - state.rotateInputTicks - 1, 0));
+    }
+
+    // A held soft drop does nothing more once the block has landed and the sound has played
+    bool softDropIdle = state.lockBlock && state.firstDrop == false && state.grid.DropDistance(state.currentBlock) == 0;
+    if ((input.softDrop && softDropIdle == false) || (input.softDrop == false && input.hardDrop))
+    {
+        quiet = std::min<int64_t>(quiet, std::max(dropAfterSpawnDelayTicks - state.dropAfterSpawnTicks - 1, 0));
+    }
+    return quiet;
+}
+
+void Engine::SkipQuietTicks(int64_t ticks)
+{
+    // Bounded by the gravity interval or the lock delay, so the int timers cannot overflow
+    state.tickCount += ticks;
+    state.inputTicks += (int)ticks;
+    state.rotateInputTicks += (int)ticks;
+    state.dropAfterSpawnTicks += (int)ticks;
+    if (state.gravity > 0)
+    {
+        state.gravityFraction = (int)((state.gravityFraction + state.gravity * ticks) % gravityUnit);
+    }
+    else
+    {
+        state.gravityTicks += (int)ticks;
+    }
+    if (state.lockBlock)
+    {
+        state.lockBlockTicks += (int)ticks;
+    }
+}
+
+const Grid& Engine::GetGrid() const
+{
+    return state.grid;
+}
+
+const Block& Engine::GetCurrentBlock() const
+{
+    return state.currentBlock;
+}
+
+const Block& Engine::GetNextBlock() const
+{
+    return state.nextBlock;
+}
+
+const PieceBag& Engine::GetBag() const
+{
+    return state.bag;
+}
+
+uint64_t Engine::GetHash() const
+{
+    // What a placement search starts from: the filled cells, the block to place
+    // and how far into its bag the game is, which fixes the pieces that can follow
+    return state.grid.GetHash() ^ zobristKeys.pieces[state.currentBlock.id] ^
+           zobristKeys.bagPositions[state.bag.GetBagPosition()];
+}
+
+int Engine::GetScore() const
+{
+    return state.score;
+}
+
+int Engine::GetLevel() const
+{
+    return state.currentLevel;
+}
+
+uint64_t Engine::GetSeed() const
+{
+    return state.seed;
+}
+
+int64_t Engine::GetTickCount() const
+{
+    return state.tickCount;
+}
+
+int Engine::GetGravityInterval() const
+{
+    // Ticks between gravity steps, rounded to the nearest tick
+    return (gravityBaseTicks + state.currentLevel / 2) / state.currentLevel;
+}
+
+int Engine::GetGravity() const
+{
+    return state.gravity;
+}
+
+bool Engine::IsGameOver() const
+{
+    return state.gameOver;
+}
+
+Block Engine::GetRandomBlock()
+{
+    return Block(state.bag.Next());
+}
+
+void Engine::HandleInput(const EngineInput& input)
+{
+    state.inputTicks++;
+    state.rotateInputTicks++;
+    state.dropAfterSpawnTicks++;
+
+    bool goodMove = false;
+
+    if (state.inputTicks >= inputDelayTicks)
+    {
+        if (input.left)
+        {
+            goodMove = MoveBlockLeft();
+            state.inputTicks = 0;
+        }
+
+        if (input.right)
+        {
+            goodMove = MoveBlockRight();
+            state.inputTicks = 0;
+        }
+    }
+
+    if (state.rotateInputTicks >= rotateInputDelayTicks)
+    {
+        if (input.rotate)
+        {
+            goodMove = RotateBlock();
+            state.rotateInputTicks = 0;
+        }
+    }
+
+    if (state.dropAfterSpawnTicks >= dropAfterSpawnDelayTicks)
+    {
+        if (input.softDrop)
+        {
+            SnakeDropBlock();
+        }
+        else if (input.hardDrop)
+        {
+            HardDropBlock();
+        }
+    }
+
+    if (goodMove)
+    {
+        if (state.lockBlock)
+        {
+            if (state.lockStateMoves < maxLockStateMoves)
+            {
+                // reset lock timer on good move
+                state.lockBlockTicks = 0;
+                state.lockStateMoves++;
+            }
+        }
+    }
+}
+
+bool Engine::MoveBlockLeft()
+{
+    state.currentBlock.Move(0, -1);
+    if (IsBlockOutside() || BlockFits() == false)
+    {
+        state.currentBlock.Move(0, 1);
+        return false;
+    }
+    UpdateGhostPiece();
+    ApplyInstantGravity();
+    return true;
+}
+
+bool Engine::MoveBlockRight()
+{
+    state.currentBlock.Move(0, 1);
+    if (IsBlockOutside() || BlockFits() == false)
+    {
+        state.currentBlock.Move(0, -1);
+        return false;
+    }
+    UpdateGhostPiece();
+    ApplyInstantGravity();
+    return true;
+}
+
+void Engine::MoveBlockDown()
+{
+    state.currentBlock.Move(1, 0);
+    if (IsBlockOutside() || BlockFits() == false)
+    {
+        state.currentBlock.Move(-1, 0);
+        state.lockBlock = true;
+
+        if (state.lockStateMoves >= maxLockStateMoves)
+        {
+            LockBlock();
+        }
+    }
+    else
+    {
+        state.lockBlockTicks = 0;
+        state.lockBlock = false;
+        state.lockStateMoves = 0;
+    }
+}
+
+void Engine::MoveBlockDown(int rows)
+{
+    // Drops up to rows at once, the landing row comes from the grid's column
+    // heights so this costs the same at 1G and 20G
+    int distance = std::min(rows, state.grid.DropDistance(state.currentBlock));
+    if (distance > 0)
+    {
+        state.currentBlock.Move(distance, 0);
+        state.lockBlockTicks = 0;
+        state.lockBlock = false;
+        state.lockStateMoves = 0;
+    }
+    if (distance < rows)
+    {
+        state.lockBlock = true;
+        if (state.lockStateMoves >= maxLockStateMoves)
+        {
+            LockBlock();
+        }
+    }
+}
+
+void Engine::ApplyFixedGravity()
+{
+    // Whole rows are dropped as the fraction adds up, the remainder carries over
+    state.gravityFraction += state.gravity;
+    int rows = state.gravityFraction / gravityUnit;
+    state.gravityFraction %= gravityUnit;
+    if (rows > 0)
+    {
+        MoveBlockDown(rows);
+    }
+}
+
+void Engine::ApplyInstantGravity()
+{
+    // At 20G the block lands within the same tick, before the next input is handled.
+    // Locking is left to the gravity step at the end of the tick.
+    if (state.gravity < instantGravity)
+    {
+        return;
+    }
+    int distance = state.grid.DropDistance(state.currentBlock);
+    if (distance > 0)
+    {
+        state.currentBlock.Move(distance, 0);
+        state.lockBlockTicks = 0;
+        state.lockStateMoves = 0;
+    }
+    state.lockBlock = true;
+}
+
+void Engine::HardDropBlock()
+{
+    state.currentBlock.Move(state.grid.DropDistance(state.currentBlock), 0);
+    LockBlock();
+}
+
+void Engine::SnakeDropBlock()
+{
+    if (state.firstDrop)
+    {
+        state.events.flags |= EventSoftDrop;
+        state.firstDrop = false;
+    }
+
+    state.currentBlock.Move(state.grid.DropDistance(state.currentBlock), 0);
+    state.lockBlock = true;
+}
+
+bool Engine::CheckBlockInAir()
+{
+    Block testBlock = state.currentBlock;
+    testBlock.Move(1, 0);
+    if (IsBlockOutside(testBlock) || BlockFits(testBlock) == false)
+    {
+        return false;
+    }
+    return true;
+}
+
+bool Engine::IsBlockOutside()
+{
+    return state.grid.IsBlockOutside(state.currentBlock);
+}
+
+const EngineState& Engine::GetState() const
+{
+    return state;
+}
+
+void Engine::SaveState(EngineState& snapshot) const
+{
+    memcpy(&snapshot, &state, sizeof(EngineState));
+}
+
+void Engine::LoadState(const EngineState& snapshot)
+{
+    memcpy(&state, &snapshot, sizeof(EngineState));
+}
+
+bool Engine::IsBlockOutside(const Block& block) const
+{
+    return state.grid.IsBlockOutside(block);
+}
+
+bool Engine::RotateBlock()
+{
+    // SRS: the turned block takes the first kick offset from its shape's table that
+    // keeps it inside the board and clear of the stack, or stays unturned if none does
+    const Block& block = state.currentBlock;
+    const KickTable& kicks = *blockShapes[block.id].kicks;
+    const Position* offsets = kicks.offsets[block.GetRotationState()];
+    Block rotated = block;
+    rotated.Rotate();
+    int kick = state.grid.FindFittingOffset(rotated, offsets, kicks.numKicks);
+    if (kick < 0)
+    {
+        return false;
+    }
+    rotated.Move(offsets[kick].row, offsets[kick].column);
+    state.currentBlock = rotated;
+    UpdateGhostPiece();
+    ApplyInstantGravity();
+    state.events.flags |= EventRotate;
+    return true;
+}
+
+bool Engine::AddGarbage(int rows, int holeColumn)
+{
+    if (state.gameOver)
+    {
+        return false;
+    }
+
+    // The falling block is carried up by the new rows when they reach it
+    bool fits = state.grid.AddGarbageRows(rows, holeColumn);
+    for (int i = 0; i < rows && fits && BlockFits() == false; i++)
+    {
+        state.currentBlock.Move(-1, 0);
+    }
+    if (fits == false || IsBlockOutside() || BlockFits() == false)
+    {
+        state.gameOver = true;
+        state.events.flags |= EventGameOver;
+    }
+    UpdateGhostPiece();
+    return state.gameOver == false;
+}
+
+void Engine::LockBlock()
+{
+    if (CheckBlockInAir())
+    {
+        return;
+    }
+
+    state.grid.PlaceBlock(state.currentBlock);
+
+    state.currentBlock = state.nextBlock;
+    state.lockBlock = false;
+    state.lockBlockTicks = 0;
+    state.lockStateMoves = 0;
+    state.dropAfterSpawnTicks = 0;  // Reset the drop delay timer when spawning new block
+
+    if (BlockFits() == false)
+    {
+        state.gameOver = true;
+        state.events.flags |= EventGameOver;
+    }
+
+    state.nextBlock = GetRandomBlock();
+    int numFullRows = state.grid.ClearFullRows();
+    if (state.gameOver == false)
+    {
+        ApplyInstantGravity();
+    }
+    UpdateGhostPiece();
+
+    if (numFullRows > 0)
+    {
+        state.events.flags |= EventLineClear;
+        state.events.clearedRows += numFullRows;
+        UpdateScore(numFullRows);
+    }
+    else
+    {
+        state.events.flags |= EventLock;
+    }
+    state.firstDrop = true;
+}
+
+void Engine::UpdateScore(int clearedRows)
+{
+    state.score += 100 * clearedRows;
+
+    if (state.score >= state.currentLevel * 1000)
+    {
+        state.currentLevel++;
+        if (state.currentLevel > 10)
+        {
+            state.currentLevel = 10;
+        }
+    }
+}
+
+bool Engine::BlockFits()
+{
+    return state.grid.BlockFits(state.currentBlock);
+}
+
+bool Engine::BlockFits(const Block& block) const
+{
+    return state.grid.BlockFits(block);
+}
+
+const Block& Engine::GetGhostPiece() const
+{
+    return state.ghostBlock;
+}
+
+void Engine::UpdateGhostPiece()
+{
+    // Dropping never changes where the block lands, so only sideways moves,
+    // rotations, spawns and state.grid changes need to call this
+    state.ghostBlock = state.currentBlock;
+    state.ghostBlock.Move(state.grid.DropDistance(state.ghostBlock), 0);
+}
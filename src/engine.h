@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+#include "grid.h"
+#include "block.h"
+#include "bag.h"
+
+// The simulation runs at a fixed rate, every timer below is counted in ticks
+const int ticksPerSecond = 60;
+
+// Fixed gravity is counted in 1/256 rows per tick, gravityUnit is 1G (one row every tick).
+// At instantGravity (20G) a block falls the whole board in one tick and lands after
+// every spawn, move and rotation.
+const int gravityUnit = 256;
+const int instantGravity = 20 * gravityUnit;
+
+// Abstract player input for one simulation tick, independent of any input device
+struct EngineInput
+{
+    bool left;
+    bool right;
+    bool rotate;
+    bool softDrop;
+    bool hardDrop;
+};
+
+enum EngineEvent
+{
+    EventRotate = 1 << 0,
+    EventSoftDrop = 1 << 1,
+    EventLock = 1 << 2,
+    EventLineClear = 1 << 3,
+    EventGameOver = 1 << 4,
+};
+
+// Events raised during one tick, flags is a combination of EngineEvent values
+struct EngineEvents
+{
+    unsigned int flags;
+    int clearedRows;
+};
+
+// Everything the simulation needs to carry on, kept as one plain value so a
+// snapshot is a single memcpy with no heap memory behind it
+struct EngineState
+{
+    Grid grid;
+    uint64_t seed;
+    PieceBag bag;
+    Block currentBlock;
+    Block nextBlock;
+    Block ghostBlock; // landing position of currentBlock, refreshed when it can change
+    int score;
+    int currentLevel;
+    bool gameOver;
+    EngineEvents events;
+
+    // timers, in ticks
+    int64_t tickCount;
+    int gravityTicks;
+    int gravity;          // fixed gravity in 1/256 rows per tick, 0 follows the level
+    int gravityFraction;  // part of a row carried over to the next tick, in 1/256 rows
+    int inputTicks;
+    int rotateInputTicks;
+    int dropAfterSpawnTicks;
+    bool lockBlock;
+    bool firstDrop;
+    int lockBlockTicks;
+    int lockStateMoves;
+};
+
+static_assert(std::is_trivially_copyable<EngineState>::value, "EngineState must stay trivially copyable");
+
+// Game rules without any window, audio or input device dependency
+class Engine
+{
+public:
+    Engine();
+    void Reset(uint64_t seed, int gravity = 0);
+    EngineEvents Tick(const EngineInput& input);
+    EngineEvents Advance(const EngineInput& input, int64_t maxTicks, int64_t& ticksAdvanced);
+
+    const Grid& GetGrid() const;
+    const Block& GetCurrentBlock() const;
+    const Block& GetNextBlock() const;
+    const PieceBag& GetBag() const;
+    int GetScore() const;
+    int GetLevel() const;
+    uint64_t GetSeed() const;
+    int64_t GetTickCount() const;
+    int GetGravityInterval() const;
+    int GetGravity() const;
+    bool IsGameOver() const;
+    uint64_t GetHash() const;
+
+    const EngineState& GetState() const;
+    void SaveState(EngineState& snapshot) const;
+    void LoadState(const EngineState& snapshot);
+
+    bool IsBlockOutside(const Block& block) const;
+    bool BlockFits(const Block& block) const;
+    const Block& GetGhostPiece() const;
+
+    bool MoveBlockLeft();
+    bool MoveBlockRight();
+    void MoveBlockDown();
+    void MoveBlockDown(int rows);
+    bool RotateBlock();
+    void HardDropBlock();
+    void SnakeDropBlock();
+    bool AddGarbage(int rows, int holeColumn);
+
+private:
+    Block GetRandomBlock();
+    void HandleInput(const EngineInput& input);
+    int64_t GetQuietTicks(const EngineInput& input) const;
+    void SkipQuietTicks(int64_t ticks);
+    bool IsBlockOutside();
+    void LockBlock();
+    void UpdateScore(int clearedRows);
+    bool BlockFits();
+    bool CheckBlockInAir();
+    void UpdateGhostPiece();
+    void ApplyFixedGravity();
+    void ApplyInstantGravity();
+
+    EngineState state;
+
+    // timings, in ticks
+    static constexpr int blockLockTicks = 18;             // 0.3 s
+    static constexpr int maxLockStateMoves = 5;
+    static constexpr int startingLevel = 1;
+    static constexpr int gravityBaseTicks = 54;           // 0.9 s per row at level 1
+    static constexpr int inputDelayTicks = 6;             // 0.1 s
+    static constexpr int rotateInputDelayTicks = 12;      // 0.2 s
+    static constexpr int dropAfterSpawnDelayTicks = 18;   // 0.3 s
+};
@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <cstdlib>
+#include "feature_tracker.h"
+
+// Bit counting in registers, std::bitset ends up in a library call per count
+// unless the build targets a CPU with popcnt
+static int Popcount(uint32_t bits)
+{
+    bits = bits - ((bits >> 1) & 0x55555555u);
+    bits = (bits & 0x33333333u) + ((bits >> 2) & 0x33333333u);
+    bits = (bits + (bits >> 4)) & 0x0F0F0F0Fu;
+    return (int)((bits * 0x01010101u) >> 24);
+}
+
+// Same counts as the batch kernels, for one row and one column at a time
+static int RowTransitions(uint16_t row)
+{
+    uint32_t walled = ((uint32_t)row << 1) | 1u | (1u << (defNumCols + 1));
+    return Popcount((walled ^ (walled >> 1)) & ((1u << (defNumCols + 1)) - 1));
+}
+
+static int ColumnTransitions(uint32_t column)
+{
+    // Bit r of the xor compares row r with the row above it, the floor is row defNumRows
+    uint32_t floored = column | (1u << defNumRows);
+    return Popcount((floored ^ (floored << 1)) & ((2u << defNumRows) - 1));
+}
+
+FeatureTracker::FeatureTracker()
+{
+    Reset(Grid());
+}
+
+FeatureTracker::FeatureTracker(const Grid& grid)
+{
+    Reset(grid);
+}
+
+void FeatureTracker::Reset(const Grid& grid)
+{
+    // A full row would have been cleared by the engine, it is cleared here too so
+    // Place only ever has to clear the rows its own block completes
+    this->grid = grid;
+    this->grid.ClearFullRows();
+    depth = 0;
+    const Grid::RowMask* masks = this->grid.GetRowMasks();
+    std::fill(columnMasks, columnMasks + defNumCols, 0u);
+    for (int row = 0; row < defNumRows; row++)
+    {
+        for (int column = 0; column < defNumCols; column++)
+        {
+            columnMasks[column] |= (uint32_t)((masks[row] >> column) & 1) << row;
+        }
+    }
+    features = BoardFeatures{0, 0, 0, 0, 0, 0, 0};
+    CountColumns(0, defNumCols - 1, 1);
+    CountRows(0, defNumRows - 1, 1);
+    UpdateMaxHeight();
+}
+
+void FeatureTracker::CountColumns(int first, int last, int sign)
+{
+    // Adds the parts of columns first to last, or with sign -1 takes away the
+    // parts they were last counted with. The columns either side only change in
+    // their wells and their bumpiness with the columns in the range. The grid's
+    // column heights must match the masks.
+    const int* heights = grid.GetColumnHeights();
+    int from = std::max(first - 1, 0);
+    int to = std::min(last + 1, defNumCols - 1);
+    for (int column = from; column <= to; column++)
+    {
+        ColumnPart& part = columnParts[column];
+        bool inside = column >= first && column <= last;
+        if (sign > 0)
+        {
+            uint32_t mask = columnMasks[column];
+            uint32_t open = (1u << (defNumRows - heights[column])) - 1;
+            uint32_t left = column > 0 ? columnMasks[column - 1] : ~0u;
+            uint32_t right = column + 1 < defNumCols ? columnMasks[column + 1] : ~0u;
+            part.wells = (int8_t)Popcount(open & left & right);
+            if (inside)
+            {
+                part.height = (int8_t)heights[column];
+                part.holes = (int8_t)(heights[column] - Popcount(mask));
+                part.transitions = (int8_t)ColumnTransitions(mask);
+            }
+        }
+        features.wells += sign * part.wells;
+        if (inside)
+        {
+            features.aggregateHeight += sign * part.height;
+            features.holes += sign * part.holes;
+            features.columnTransitions += sign * part.transitions;
+        }
+        if (column > from && column - 1 <= last)
+        {
+            features.bumpiness += sign * std::abs(part.height - columnParts[column - 1].height);
+        }
+    }
+}
+
+void FeatureTracker::CountRows(int first, int last, int sign)
+{
+    const Grid::RowMask* masks = grid.GetRowMasks();
+    for (int row = first; row <= last; row++)
+    {
+        features.rowTransitions += sign * RowTransitions(masks[row]);
+    }
+}
+
+void FeatureTracker::UpdateMaxHeight()
+{
+    features.maxHeight = 0;
+    for (const ColumnPart& part : columnParts)
+    {
+        features.maxHeight = std::max(features.maxHeight, (int)part.height);
+    }
+}
+
+int FeatureTracker::Place(const Block& block)
+{
+    // The block must fit inside the grid, as for Grid::PlaceBlock. Returns the
+    // number of rows cleared.
+    const BlockRotation& shape = block.GetRotation();
+    int firstRow = block.GetRowOffset() + shape.minRow;
+    int lastRow = block.GetRowOffset() + shape.maxRow;
+    int firstColumn = block.GetColumnOffset() + shape.minColumn;
+    int lastColumn = block.GetColumnOffset() + shape.maxColumn;
+
+    bool clears = false;
+    for (int i = shape.minRow; i <= shape.maxRow; i++)
+    {
+        int column = block.GetColumnOffset();
+        uint16_t cells = (uint16_t)(column >= 0 ? shape.rowMasks[i] << column : shape.rowMasks[i] >> -column);
+        clears = clears || (grid.GetRowMask(block.GetRowOffset() + i) | cells) == Grid::fullRowMask;
+    }
+
+    if (depth == (int)history.size())
+    {
+        history.emplace_back();
+    }
+    Placement& placement = history[depth++];
+    placement.block = block;
+    placement.clearedRows = 0;
+    if (clears)
+    {
+        placement.grid = grid;
+        std::copy(columnMasks, columnMasks + defNumCols, placement.columnMasks);
+        std::copy(columnParts, columnParts + defNumCols, placement.columnParts);
+        placement.features = features;
+    }
+
+    // Clearing rows moves every column down, so all of them are counted again
+    CountColumns(clears ? 0 : firstColumn, clears ? defNumCols - 1 : lastColumn, -1);
+    CountRows(firstRow, lastRow, -1);
+    grid.PlaceBlock(block);
+    for (Position cell : block.GetCellPositions())
+    {
+        columnMasks[cell.column] |= 1u << cell.row;
+    }
+    CountRows(firstRow, lastRow, 1);
+
+    if (clears == false)
+    {
+        CountColumns(firstColumn, lastColumn, 1);
+        UpdateMaxHeight();
+        return 0;
+    }
+
+    for (int row = firstRow; row <= lastRow; row++)
+    {
+        if (grid.GetRowMask(row) != Grid::fullRowMask)
+        {
+            continue;
+        }
+        // Rows above the cleared one move down a bit, top to bottom keeps the
+        // rows still to clear where they are
+        uint32_t above = (1u << row) - 1;
+        for (int column = 0; column < defNumCols; column++)
+        {
+            uint32_t mask = columnMasks[column];
+            columnMasks[column] = (mask & ~(above | (1u << row))) | ((mask & above) << 1);
+        }
+        placement.clearedRows++;
+    }
+    grid.ClearFullRows();
+
+    // Full rows have no row transitions and the empty rows that replace them have two each
+    features.rowTransitions += 2 * placement.clearedRows;
+    CountColumns(0, defNumCols - 1, 1);
+    UpdateMaxHeight();
+    return placement.clearedRows;
+}
+
+void FeatureTracker::Undo()
+{
+    if (depth == 0)
+    {
+        return;
+    }
+    const Placement& placement = history[--depth];
+    if (placement.clearedRows > 0)
+    {
+        grid = placement.grid;
+        std::copy(placement.columnMasks, placement.columnMasks + defNumCols, columnMasks);
+        std::copy(placement.columnParts, placement.columnParts + defNumCols, columnParts);
+        features = placement.features;
+        return;
+    }
+
+    const Block& block = placement.block;
+    const BlockRotation& shape = block.GetRotation();
+    int firstRow = block.GetRowOffset() + shape.minRow;
+    int lastRow = block.GetRowOffset() + shape.maxRow;
+    int firstColumn = block.GetColumnOffset() + shape.minColumn;
+    int lastColumn = block.GetColumnOffset() + shape.maxColumn;
+
+    CountColumns(firstColumn, lastColumn, -1);
+    CountRows(firstRow, lastRow, -1);
+    for (Position cell : block.GetCellPositions())
+    {
+        grid.SetCell(cell.row, cell.column, 0);
+        columnMasks[cell.column] &= ~(1u << cell.row);
+    }
+    CountColumns(firstColumn, lastColumn, 1);
+    CountRows(firstRow, lastRow, 1);
+    UpdateMaxHeight();
+}
+
+int FeatureTracker::GetDepth() const
+{
+    return depth;
+}
+
+const Grid& FeatureTracker::GetGrid() const
+{
+    return grid;
+}
+
+const BoardFeatures& FeatureTracker::GetFeatures() const
+{
+    return features;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "board_features.h"
+
+// A grid together with its BoardFeatures, kept up to date as blocks are placed
+// and taken back. Every feature is a sum of per-column parts (height, holes,
+// column transitions, wells, bumpiness between neighbours) and per-row parts
+// (row transitions), so a placement only recounts the columns next to the block
+// and the rows it covers. Clearing rows moves every column down and recounts
+// all of them, but not the rows above, whose parts move down unchanged.
+// Undo replays the same recount in reverse, a placement that cleared rows is
+// taken back by restoring the grid saved before it.
+class FeatureTracker
+{
+public:
+    FeatureTracker();
+    explicit FeatureTracker(const Grid& grid);
+    void Reset(const Grid& grid);
+    int Place(const Block& block);
+    void Undo();
+    int GetDepth() const;
+    const Grid& GetGrid() const;
+    const BoardFeatures& GetFeatures() const;
+
+private:
+    // What one column adds to the features, kept so it can be taken away again
+    struct ColumnPart
+    {
+        int8_t height;
+        int8_t holes;
+        int8_t transitions;
+        int8_t wells;
+    };
+
+    // What Undo needs to take a placement back
+    struct Placement
+    {
+        Block block;
+        int clearedRows;
+        Grid grid;                          // only saved when rows were cleared
+        uint32_t columnMasks[defNumCols];
+        ColumnPart columnParts[defNumCols];
+        BoardFeatures features;
+    };
+
+    void CountColumns(int first, int last, int sign);
+    void CountRows(int first, int last, int sign);
+    void UpdateMaxHeight();
+
+    Grid grid;
+    uint32_t columnMasks[defNumCols]; // bit r set when row r of the column is filled
+    ColumnPart columnParts[defNumCols];
+    BoardFeatures features;
+    std::vector<Placement> history;   // grows to the deepest search, then reused
+    int depth;
+};
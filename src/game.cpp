@@ -5,18 +5,8 @@
 
 #include "game.h"
 
-float lastUpdateTime = 0.0f;
-
-bool EventTriggered(float interval)
-{
-    float currentTime = GetTime();
-    if (currentTime - lastUpdateTime >= interval)
-    {
-        lastUpdateTime = currentTime;
-        return true;
-    }
-    return false;
-}
+// Enough runs for a long game, so recording does not grow the vector mid-frame
+static const size_t replayReserveRuns = 1 << 15;
 
 Game::Game()
 {
@@ -35,6 +25,15 @@ Game::Game()
     buttonPadding = 20.0f;
     buttonColor = {200, 200, 200, 200}; // Semi-transparent white
     arrowColor = {50, 50, 50, 255}; // Dark gray for arrows
+    replayPlayback = false;
+    botEnabled = false;
+    gravity = 0;
+    scrubbing = false;
+    scrubTick = 0.0;
+    showAllocStats = false;
+    allocBudget = -1;
+    allocBudgetExceeded = false;
+    replay.Reserve(replayReserveRuns);
     
     // Check if running on a mobile device
     #ifdef __EMSCRIPTEN__
@@ -56,8 +55,6 @@ void Game::InitializeResources()
     }
     SetTextureFilter(targetRenderTex.texture, TEXTURE_FILTER_BILINEAR);
 
-    grid = Grid();
-    
     font = LoadFontEx("Font/monogram.ttf", 64, 0, 0);
     if (!font.texture.id) {
         throw std::runtime_error("Failed to load font");
@@ -109,85 +106,89 @@ void Game::StartAudio()
 
 void Game::InitGame()
 {
-    // Initialize grid first
-    grid.Initialize();
-    
-    // Initialize blocks with error handling
-    blocks = GetAllBlocks();
-    currentBlock = GetRandomBlock();
-    nextBlock = GetRandomBlock();
-    
-    // Initialize other game state
-    score = 0;
+    if (replayPlayback)
+    {
+        engine.Reset(replay.GetSeed(), replay.GetGravity());
+        replayPlayer.Start(replay);
+    }
+    else
+    {
+        std::random_device randomDevice;
+        uint64_t seed = ((uint64_t)randomDevice() << 32) | randomDevice();
+        engine.Reset(seed, gravity);
+        replay.Reset(seed, gravity);
+    }
+    tickAccumulator = 0.0;
+    bot.Reset();
+    rewind.Clear();
+    scrubbing = false;
     highScore = LoadHighScoreFromFile();
-    lockBlockTimer = 0.0f;
-    lockBlock = false;
-    firstDrop = true;
-    lockStateMoves = 0;
-    currentLevel = startingLevel;
-    lastInputTime = inputDelay;
-    lastRotateInputTime = rotateInputDelay;
-    lastDropAfterSpawnTime = 0.0f;  // Initialize the new drop delay timer
 }
 
 void Game::Reset()
 {
     firstTimeGameStart = false;
-    firstDrop = true;
     isFirstFrameAfterReset = true;
     isInExitMenu = false;
     paused = false;
     lostWindowFocus = false;
     gameOver = false;
     exitWindowRequested = false;
+    replayPlayback = false;
     InitGame();
 }
 
-Game::~Game()
+bool Game::StartReplay(const std::string& path)
 {
-    UnloadRenderTexture(targetRenderTex);
-    UnloadFont(font);
-    UnloadSound(rotateSound);
-    UnloadSound(clearSound);
-    UnloadSound(dropSound);
-    UnloadSound(lockSound);
-    UnloadMusicStream(backgroundMusic);
+    if (!replay.Load(path))
+    {
+        return false;
+    }
+    replayPlayback = true;
+    InitGame();
+    return true;
 }
 
-Block Game::GetRandomBlock()
+void Game::SetGravity(int gravity)
 {
-    if (blocks.empty())
+    this->gravity = gravity;
+    if (replayPlayback == false)
     {
-        blocks = GetAllBlocks();
-    }
-    
-    if (blocks.empty()) {
-        // Return a default block if somehow we have no blocks
-        return Block();
+        InitGame();
     }
-    
-    int randomIndex = rand() % blocks.size();  
-    Block block = blocks[randomIndex];
-    blocks.erase(blocks.begin() + randomIndex);
-    return block;
 }
 
-std::vector<Block> Game::GetAllBlocks()
+void Game::SetBotBeam(int width, int depth)
 {
-    std::vector<Block> allBlocks;
-    allBlocks.reserve(7); // Pre-allocate space for all blocks    
-    allBlocks.push_back(IBlock());
-    allBlocks.push_back(JBlock());
-    allBlocks.push_back(LBlock());
-    allBlocks.push_back(OBlock());
-    allBlocks.push_back(SBlock());
-    allBlocks.push_back(TBlock());
-    allBlocks.push_back(ZBlock());
-    return allBlocks;
+    bot.SetBeam(width, depth);
+}
+
+void Game::SetBotRollouts(int depth, int count, double budgetSeconds)
+{
+    bot.SetRollouts(depth, count, budgetSeconds, 0);
+}
+
+void Game::SaveReplayToFile()
+{
+    AllocScope allocScope(allocStats, PhaseFileIO);
+    replay.Save("lastgame.replay");
+}
+
+Game::~Game()
+{
+    UnloadRenderTexture(targetRenderTex);
+    UnloadFont(font);
+    UnloadSound(rotateSound);
+    UnloadSound(clearSound);
+    UnloadSound(dropSound);
+    UnloadSound(lockSound);
+    UnloadMusicStream(backgroundMusic);
 }
 
 void Game::Update()
 {
+    allocStats.BeginFrame();
+    AllocScope allocScope(allocStats, PhaseUpdate);
     screenScale = MIN((float)GetScreenWidth() / gameScreenWidth, (float)GetScreenHeight() / gameScreenHeight);
     UpdateUI();
     
@@ -195,47 +196,149 @@ void Game::Update()
         UpdateMusicStream(backgroundMusic);
     }
 
+    bool canRewind = (firstTimeGameStart == false && isInExitMenu == false && gameOver == false && replayPlayback == false);
+    if (canRewind && (IsKeyDown(KEY_R) || IsKeyDown(KEY_T)))
+    {
+        Scrub(IsKeyDown(KEY_R) ? -1 : 1);
+        return;
+    }
+    if (scrubbing)
+    {
+        EndScrub();
+    }
+
     bool running = (firstTimeGameStart == false && paused == false && lostWindowFocus == false && isInExitMenu == false && gameOver == false);
     if (running)
     {
-        HandleInput();        
-        if (EventTriggered(0.9f / currentLevel))
+        // Run as many fixed ticks as the frame time covers, so the simulation
+        // does not depend on the render rate
+        EngineInput input = HandleInput();
+        tickAccumulator = MIN(tickAccumulator + GetFrameTime(), maxFrameTime);
+        while (tickAccumulator >= tickTime && gameOver == false)
         {
-            MoveBlockDown();
+            tickAccumulator -= tickTime;
+            if (replayPlayback)
+            {
+                if (replayPlayer.IsFinished())
+                {
+                    gameOver = true;
+                    break;
+                }
+                input = replayPlayer.Next();
+            }
+            else
+            {
+                if (botEnabled)
+                {
+                    input = bot.NextInput(engine);
+                }
+                replay.Record(input);
+            }
+            rewind.Record(engine, input);
+            EngineEvents events = engine.Tick(input);
+            HandleEngineEvents(events);
         }
+    }
+}
+
+void Game::Scrub(int direction)
+{
+    if (!scrubbing)
+    {
+        scrubbing = true;
+        scrubTick = (double)engine.GetTickCount();
+    }
+
+    if (rewind.GetOldestTick() < 0)
+    {
+        return;
+    }
+    scrubTick += direction * scrubSpeed * GetFrameTime() * ticksPerSecond;
+    scrubTick = MAX(scrubTick, (double)rewind.GetOldestTick());
+    scrubTick = MIN(scrubTick, (double)rewind.GetNewestTick());
+
+    int64_t targetTick = (int64_t)scrubTick;
+    if (targetTick != engine.GetTickCount())
+    {
+        rewind.Seek(engine, targetTick);
+    }
+}
 
-        if (lockBlock)
+void Game::EndScrub()
+{
+    // The inputs after the scrub position are forgotten, the replay matches the new timeline
+    rewind.Truncate(engine.GetTickCount());
+    replay.Truncate(engine.GetTickCount());
+    bot.Reset();
+    scrubbing = false;
+    tickAccumulator = 0.0;
+}
+
+void Game::HandleEngineEvents(const EngineEvents& events)
+{
+    if (events.flags & EventRotate)
+    {
+        PlaySound(rotateSound);
+    }
+    if (events.flags & EventSoftDrop)
+    {
+        PlaySound(dropSound);
+    }
+    if (events.flags & EventLineClear)
+    {
+        PlaySound(clearSound);
+        CheckForHighScore();
+    }
+    else if (events.flags & EventLock)
+    {
+        PlaySound(lockSound);
+    }
+    if (events.flags & EventGameOver)
+    {
+        gameOver = true;
+        if (!replayPlayback)
         {
-            lockBlockTimer += GetFrameTime();
-            if (lockBlockTimer > blockLockTime)
-            {
-                LockBlock();
-            }
+            SaveReplayToFile();
         }
     }
 }
 
 void Game::Draw()
 {
-    // render everything to a texture
-    BeginTextureMode(targetRenderTex);      
-    ClearBackground(BLACK);        
-    grid.Draw();
-    DrawGhostPiece();  // Draw ghost piece before the current block
-    currentBlock.Draw(0, 0);
-    DrawUI();     
-    EndTextureMode();
-    // render the scaled frame texture to the screen
-    BeginDrawing();     
-    ClearBackground(BLACK);     
-    DrawTexturePro(targetRenderTex.texture, (Rectangle){0.0f, 0.0f, (float)targetRenderTex.texture.width, (float)-targetRenderTex.texture.height},
-                   (Rectangle){(GetScreenWidth() - ((float)gameScreenWidth * screenScale)) * 0.5f, (GetScreenHeight() - ((float)gameScreenHeight * screenScale)) * 0.5f, (float)gameScreenWidth * screenScale, (float)gameScreenHeight * screenScale},
-                   (Vector2){0, 0}, 0.0f, WHITE);
-    EndDrawing();
+    {
+        AllocScope allocScope(allocStats, PhaseDraw);
+
+        // render everything to a texture
+        BeginTextureMode(targetRenderTex);
+        ClearBackground(BLACK);
+        {
+            AllocScope gridScope(allocStats, PhaseGridDraw);
+            engine.GetGrid().Draw();
+        }
+        DrawGhostPiece();  // Draw ghost piece before the current block
+        engine.GetCurrentBlock().Draw(0, 0);
+        DrawUI();
+        if (showAllocStats)
+        {
+            DrawAllocStats();
+        }
+        EndTextureMode();
+        // render the scaled frame texture to the screen
+        BeginDrawing();
+        ClearBackground(BLACK);
+        DrawTexturePro(targetRenderTex.texture, (Rectangle){0.0f, 0.0f, (float)targetRenderTex.texture.width, (float)-targetRenderTex.texture.height},
+                       (Rectangle){(GetScreenWidth() - ((float)gameScreenWidth * screenScale)) * 0.5f, (GetScreenHeight() - ((float)gameScreenHeight * screenScale)) * 0.5f, (float)gameScreenWidth * screenScale, (float)gameScreenHeight * screenScale},
+                       (Vector2){0, 0}, 0.0f, WHITE);
+        EndDrawing();
+    }
+    allocStats.EndFrame();
+    CheckAllocBudget();
 }
 
 void Game::DrawUI()
 {
+    AllocScope allocScope(allocStats, PhaseDrawUI);
+
     // Check if resources are ready
     if (!font.texture.id) {
         return;
@@ -245,19 +348,30 @@ void Game::DrawUI()
     
     DrawTextEx(font, "Score", {365, 15}, fontSize, 2, WHITE);
     DrawRectangleRounded(Rectangle{320, 55, 170, 60}, 0.3, 6, darkGrey);    
-    std::string scoreText = FormatWithLeadingZeroes(score, 7);
-    DrawTextEx(font, scoreText.c_str(), {355, 65}, fontSize, 2, WHITE);
+    DrawTextEx(font, FormatWithLeadingZeroes(engine.GetScore(), 7), {355, 65}, fontSize, 2, WHITE);
 
     DrawTextEx(font, "High Score", {325, 135}, fontSize, 2, WHITE);
     DrawRectangleRounded(Rectangle{320, 175, 170, 60}, 0.3, 6, darkGrey);
-    std::string highScoreText = FormatWithLeadingZeroes(highScore, 7);
-    DrawTextEx(font, highScoreText.c_str(), {355, 185}, fontSize, 2, WHITE);
+    DrawTextEx(font, FormatWithLeadingZeroes(highScore, 7), {355, 185}, fontSize, 2, WHITE);
 
     DrawRectangleRounded(Rectangle{320, 275, 170, 180}, 0.3, 6, darkGrey);
     DrawTextEx(font, "Next", {365, 275}, fontSize, 2, WHITE);
-    nextBlock.Draw(245, 295); // Center the next piece in its preview box
+    engine.GetNextBlock().Draw(245, 295); // Center the next piece in its preview box
 
-    DrawTextEx(font, TextFormat("Level: %d", currentLevel), {350, 460}, fontSize, 2, WHITE);
+    DrawTextEx(font, TextFormat("Level: %d", engine.GetLevel()), {350, 460}, fontSize, 2, WHITE);
+    if (replayPlayback)
+    {
+        DrawTextEx(font, "Replay", {365, 580}, fontSize, 2, yellow);
+    }
+    else if (botEnabled && scrubbing == false)
+    {
+        DrawTextEx(font, "Bot", {385, 580}, fontSize, 2, yellow);
+    }
+    else if (scrubbing)
+    {
+        float secondsBack = (float)(rewind.GetNewestTick() - engine.GetTickCount()) / ticksPerSecond;
+        DrawTextEx(font, TextFormat("Rewind -%.1fs", secondsBack), {325, 580}, fontSize, 2, yellow);
+    }
     
     // Draw music toggle text under the Level text
     if(!isMobile) {
@@ -389,15 +503,16 @@ void Game::DrawUI()
 
 void Game::CheckForHighScore()
 {
-    if (score > highScore)
+    if (engine.GetScore() > highScore)
     {
-        highScore = score;
+        highScore = engine.GetScore();
         SaveHighScoreToFile();
     }
 }
 
 void Game::SaveHighScoreToFile()
 {
+    AllocScope allocScope(allocStats, PhaseFileIO);
     std::ofstream highScoreFile("highscore.txt");
     if (highScoreFile.is_open())
     {
@@ -408,6 +523,7 @@ void Game::SaveHighScoreToFile()
 
 int Game::LoadHighScoreFromFile()
 {
+    AllocScope allocScope(allocStats, PhaseFileIO);
     int loadedHighScore = 0;
     std::ifstream highscoreFile("highscore.txt");
     if (highscoreFile.is_open())
@@ -418,95 +534,92 @@ int Game::LoadHighScoreFromFile()
     return loadedHighScore;
 }
 
-std::string Game::FormatWithLeadingZeroes(int number, int width)
+const char* Game::FormatWithLeadingZeroes(int number, int width)
 {
     if (width <= 0) {
         return "0";
     }
-    
-    std::string numberText = std::to_string(number);
-    if (numberText.length() > width) {
-        return std::string(width, '9');
-    }
-    
-    int leadingZeros = width - numberText.length();
-    if (leadingZeros < 0) {
-        leadingZeros = 0;
+
+    // Formatted into raylib's static text buffer, numbers too wide for the field show as all nines
+    int maxNumber = 1;
+    for (int i = 0; i < width && maxNumber <= INT32_MAX / 10; i++) {
+        maxNumber *= 10;
     }
-    
-    return std::string(leadingZeros, '0') + numberText;
+    return TextFormat("%0*d", width, MIN(number, maxNumber - 1));
 }
 
-void Game::HandleInput()
+void Game::SetAllocBudget(int64_t maxAllocsPerFrame)
 {
-    if (isFirstFrameAfterReset)
-    {
-        isFirstFrameAfterReset = false;
-        return;
-    }
+    allocBudget = maxAllocsPerFrame;
+}
 
-    lastInputTime += GetFrameTime();
-    lastRotateInputTime += GetFrameTime();
-    lastDropAfterSpawnTime += GetFrameTime();  // Update the drop delay timer
+bool Game::IsAllocBudgetExceeded() const
+{
+    return allocBudgetExceeded;
+}
 
-    bool goodMove = false;
+bool Game::ExportAllocStats(const std::string& path) const
+{
+    return allocStats.Export(path);
+}
 
-    if (lastInputTime >= inputDelay)
+void Game::CheckAllocBudget()
+{
+    if (allocBudget < 0 || allocBudgetExceeded || allocStats.GetLastFrame().count <= (uint64_t)allocBudget)
     {
-        if (IsKeyDown(KEY_LEFT) || IsKeyDown(KEY_A) || (isMobile && IsMouseButtonDown(MOUSE_LEFT_BUTTON) && CheckTouchInLeftButton()))
-        {
-            goodMove = MoveBlockLeft();
-            if (goodMove)
-            {
-                //PlaySound(rotateSound);
-            }
-            lastInputTime = 0.0f;
-        }
+        return;
+    }
 
-        if (IsKeyDown(KEY_RIGHT) || IsKeyDown(KEY_D) || (isMobile && IsMouseButtonDown(MOUSE_LEFT_BUTTON) && CheckTouchInRightButton()))
-        {
-            goodMove = MoveBlockRight();
-            lastInputTime = 0.0f;
-            if (goodMove)
-            {
-                //PlaySound(rotateSound);
-            }
-        }
+    allocBudgetExceeded = true;
+    exitWindow = true;
+    std::cerr << "Allocation budget exceeded in frame " << allocStats.GetFrameCount() << ": "
+              << allocStats.GetLastFrame().count << " allocations, budget " << allocBudget << "\n";
+    for (int i = 0; i < numAllocPhases; i++)
+    {
+        const AllocCounters& phase = allocStats.GetLastPhase((AllocPhase)i);
+        std::cerr << "  " << GetAllocPhaseName((AllocPhase)i) << ": " << phase.count << " allocations, " << phase.bytes << " bytes\n";
     }
+}
 
-    if (lastRotateInputTime >= rotateInputDelay)
+void Game::DrawAllocStats()
+{
+    DrawRectangle(10, 10, 300, 30 + 15 * numAllocPhases, {0, 0, 0, 200});
+    if (!AllocStatsEnabled())
     {
-        if (IsKeyDown(KEY_UP) || IsKeyDown(KEY_W) || (isMobile && IsMouseButtonDown(MOUSE_LEFT_BUTTON) && CheckTouchInUpButton()))
-        {
-            goodMove = RotateBlock();
-            lastRotateInputTime = 0.0f;
-        }
+        DrawText("Built without TETRIS_ALLOC_STATS", 15, 15, 10, WHITE);
+        return;
     }
 
-    if (lastDropAfterSpawnTime >= dropAfterSpawnDelay)
+    const AllocCounters& frame = allocStats.GetLastFrame();
+    const AllocCounters& peak = allocStats.GetPeakFrame();
+    DrawText(TextFormat("Frame: %llu allocs %llu B, peak %llu", (unsigned long long)frame.count, (unsigned long long)frame.bytes,
+                        (unsigned long long)peak.count), 15, 15, 10, frame.count > 0 ? yellow : WHITE);
+    for (int i = 0; i < numAllocPhases; i++)
     {
-        if (IsKeyDown(KEY_DOWN) || IsKeyDown(KEY_S) || (isMobile && IsMouseButtonDown(MOUSE_LEFT_BUTTON) && CheckTouchInDownButton()))
-        {
-            SnakeDropBlock();
-        }
-        else if (IsKeyDown(KEY_SPACE))
-        {
-            HardDropBlock();
-        }
+        const AllocCounters& last = allocStats.GetLastPhase((AllocPhase)i);
+        const AllocCounters& phasePeak = allocStats.GetPeakPhase((AllocPhase)i);
+        DrawText(TextFormat("%s: %llu allocs %llu B, peak %llu", GetAllocPhaseName((AllocPhase)i), (unsigned long long)last.count,
+                            (unsigned long long)last.bytes, (unsigned long long)phasePeak.count), 15, 30 + 15 * i, 10, WHITE);
     }
+}
 
-    if (goodMove)
+EngineInput Game::HandleInput()
+{
+    AllocScope allocScope(allocStats, PhaseHandleInput);
+    EngineInput input = {false, false, false, false, false};
+    if (isFirstFrameAfterReset)
     {
-        if (lockBlock)
-        {
-            if (lockStateMoves < maxLockStateMoves)
-            {
-                // reset lock timer on good move
-                lockBlockTimer = 0.0f;
-                lockStateMoves++;
-            }
-        }
+        isFirstFrameAfterReset = false;
+        return input;
     }
+
+    bool touching = isMobile && IsMouseButtonDown(MOUSE_LEFT_BUTTON);
+    input.left = IsKeyDown(KEY_LEFT) || IsKeyDown(KEY_A) || (touching && CheckTouchInLeftButton());
+    input.right = IsKeyDown(KEY_RIGHT) || IsKeyDown(KEY_D) || (touching && CheckTouchInRightButton());
+    input.rotate = IsKeyDown(KEY_UP) || IsKeyDown(KEY_W) || (touching && CheckTouchInUpButton());
+    input.softDrop = IsKeyDown(KEY_DOWN) || IsKeyDown(KEY_S) || (touching && CheckTouchInDownButton());
+    input.hardDrop = IsKeyDown(KEY_SPACE);
+    return input;
 }
 
 bool Game::CheckTouchInUpButton()
@@ -610,6 +723,17 @@ void Game::UpdateUI()
     }    
 #endif
 
+    if (IsKeyPressed(KEY_F3))
+    {
+        showAllocStats = !showAllocStats;
+    }
+
+    if (IsKeyPressed(KEY_B) && replayPlayback == false)
+    {
+        botEnabled = !botEnabled;
+        bot.Reset();
+    }
+
     // Handle music toggle
     if (IsKeyPressed(KEY_M))
     {
@@ -687,327 +811,11 @@ void Game::UpdateUI()
     }
 }
 
-bool Game::MoveBlockLeft()
-{
-    currentBlock.Move(0, -1);
-    if (IsBlockOutside() || BlockFits() == false)
-    {
-        currentBlock.Move(0, 1);
-        return false;
-    }
-    return true;
-}
-
-bool Game::MoveBlockLeftRepeat(int count)
-{
-    currentBlock.Move(0, -count);
-    if (IsBlockOutside() || BlockFits() == false)
-    {
-        currentBlock.Move(0, count);
-        return false;
-    }
-    return true;
-}
-
-bool Game::MoveBlockRight()
-{
-    currentBlock.Move(0, 1);
-    if (IsBlockOutside() || BlockFits() == false)
-    {
-        currentBlock.Move(0, -1);
-        return false;
-    }
-    return true;
-}
-
-bool Game::MoveBlockRightRepeat(int count)
-{
-    currentBlock.Move(0, count);
-    if (IsBlockOutside() || BlockFits() == false)
-    {
-        currentBlock.Move(0, -count);
-        return false;
-    }
-    return true;
-}
-
-bool Game::MoveBlockUpRepeat(int count)
-{
-    currentBlock.Move(-count, 0);
-    if (IsBlockOutside() || BlockFits() == false)
-    {
-        currentBlock.Move(count, 0);
-        return false;
-    }
-    return true;
-}
-
-void Game::MoveBlockDown()
-{
-    currentBlock.Move(1, 0);
-    if (IsBlockOutside() || BlockFits() == false)
-    {
-        currentBlock.Move(-1, 0);
-        lockBlock = true;
-        // std::cout << "LM: " <<lockStateMoves << "\n";
-
-        if (lockStateMoves >= maxLockStateMoves)
-        {
-            LockBlock();
-        }
-    }
-    else
-    {
-        lockBlockTimer = 0.0f;
-        lockBlock = false;
-        lockStateMoves = 0;
-    }
-}
-
-void Game::HardDropBlock()
-{
-    while (true)
-    {
-        currentBlock.Move(1, 0);
-        if (IsBlockOutside() || BlockFits() == false)
-        {
-            currentBlock.Move(-1, 0);
-            LockBlock();
-            break;
-        }
-    }
-}
-
-void Game::SnakeDropBlock()
-{
-    if(firstDrop) 
-    {
-        PlaySound(dropSound);
-        firstDrop = false;
-    }        
-
-    while (true)
-    {
-        currentBlock.Move(1, 0);
-        if (IsBlockOutside() || BlockFits() == false)
-        {
-            currentBlock.Move(-1, 0);
-            lockBlock = true;
-            break;
-        }
-    }
-}
-
-bool Game::CheckBlockInAir()
-{
-    Block testBlock = currentBlock;
-    testBlock.Move(1, 0);
-    if (IsBlockOutside(testBlock) || BlockFits(testBlock) == false)
-    {
-        return false;
-    }
-    return true;
-}
-
-bool Game::IsBlockOutside()
-{
-    std::vector<Position> tiles = currentBlock.GetCellPositions();
-    for (Position item : tiles)
-    {
-        if (grid.IsCellOutside(item.row, item.column))
-        {
-            return true;
-        }
-    }
-    return false;
-}
-
-bool Game::IsBlockOutside(Block block)
-{
-    std::vector<Position> tiles = block.GetCellPositions();
-    for (Position item : tiles)
-    {
-        if (grid.IsCellOutside(item.row, item.column))
-        {
-            return true;
-        }
-    }
-    return false;
-}
-
-void Game::TryToMoveBlockInside()
-{
-    std::vector<Position> tiles = currentBlock.GetCellPositions();
-
-    int numMovesLeft = 0;
-    int numMovesRight = 0;
-    int numMovesUp = 0;
-    int n;
-
-    for (Position item : tiles)
-    {
-        if (item.column < 0)
-        {
-            n = item.column;
-            if (numMovesRight < -n)
-            {
-                numMovesRight = -n;
-                // std::cout << "numMovesRight: " << numMovesRight << "\n";
-            }
-        }
-        else if (item.column > grid.GetNumCols() - 1)
-        {
-            n = item.column - (grid.GetNumCols() - 1);
-            if (numMovesLeft < n)
-            {
-                numMovesLeft = n;
-                // std::cout << "numMovesLeft: " << numMovesLeft << "\n";
-            }
-        }
-
-        if (item.row > grid.GetNumRows() - 1)
-        {
-            n = item.row - (grid.GetNumRows() - 1);
-            if (numMovesUp < n)
-            {
-                numMovesUp = n;
-            }
-        }
-    }
-
-    if (numMovesLeft)
-    {
-        MoveBlockLeftRepeat(numMovesLeft);
-    }
-    else if (numMovesRight)
-    {
-        MoveBlockRightRepeat(numMovesRight);
-    }
-    if (numMovesUp)
-    {
-        MoveBlockUpRepeat(numMovesUp);
-    }
-}
-
-bool Game::RotateBlock()
-{
-    currentBlock.Rotate();
-    if (IsBlockOutside())
-    {
-        TryToMoveBlockInside();
-    }
-
-    if (IsBlockOutside() || BlockFits() == false)
-    {
-        currentBlock.UndoRotation();
-        return false;
-    }
-    PlaySound(rotateSound);
-    return true;
-}
-
-void Game::LockBlock()
-{
-    if (CheckBlockInAir())
-    {
-        return;
-    }
-
-    std::vector<Position> tiles = currentBlock.GetCellPositions();
-    for (Position item : tiles)
-    {
-        grid.grid[item.row][item.column] = currentBlock.id;
-    }
-
-    currentBlock = nextBlock;
-    lockBlock = false;
-    lockBlockTimer = 0.0f;
-    lockStateMoves = 0;
-    lastDropAfterSpawnTime = 0.0f;  // Reset the drop delay timer when spawning new block
-
-    if (BlockFits() == false)
-    {
-        gameOver = true;
-    }
-
-    nextBlock = GetRandomBlock();
-    int numFullRows = grid.ClearFullRows();
-
-    if (numFullRows > 0)
-    {
-        PlaySound(clearSound);
-        UpdateScore(numFullRows);
-    }
-    else
-    {
-        PlaySound(lockSound);
-    }
-    firstDrop = true;
-}
-
-void Game::UpdateScore(int clearedRows)
-{
-    score += 100 * clearedRows;
-
-    if (score >= currentLevel * 1000)
-    {
-        currentLevel++;
-        if (currentLevel > 10)
-        {
-            currentLevel = 10;
-        }
-    }
-
-    CheckForHighScore();
-}
-
-bool Game::BlockFits()
-{
-    std::vector<Position> tiles = currentBlock.GetCellPositions();
-
-    for (Position item : tiles)
-    {
-        if (grid.IsCellEmpty(item.row, item.column) == false)
-        {
-            return false;
-        }
-    }
-    return true;
-}
-
-bool Game::BlockFits(Block block)
-{
-    std::vector<Position> tiles = block.GetCellPositions();
-
-    for (Position item : tiles)
-    {
-        if (grid.IsCellEmpty(item.row, item.column) == false)
-        {
-            return false;
-        }
-    }
-    return true;
-}
-
-Block Game::GetGhostPiece()
-{
-    Block ghost = currentBlock;
-    while (true)
-    {
-        ghost.Move(1, 0);
-        if (IsBlockOutside(ghost) || BlockFits(ghost) == false)
-        {
-            ghost.Move(-1, 0);
-            break;
-        }
-    }
-    return ghost;
-}
-
 void Game::DrawGhostPiece()
 {
-    Block ghost = GetGhostPiece();
-    std::vector<Position> tiles = ghost.GetCellPositions();
+    AllocScope allocScope(allocStats, PhaseDrawGhostPiece);
+    const Block& ghost = engine.GetGhostPiece();
+    BlockCells tiles = ghost.GetCellPositions();
     static const int blockGridPadding = gridThickness + 1;
     
     for (Position item : tiles)
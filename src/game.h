@@ -1,8 +1,11 @@
 #pragma once
 #include <string>
 #include "globals.h"
-#include "grid.h"
-#include "blocks.h"
+#include "engine.h"
+#include "replay.h"
+#include "alloc_stats.h"
+#include "rewind.h"
+#include "bot.h"
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
 #endif
@@ -23,17 +26,26 @@ public:
     Game &&operator=(Game &&g) = delete;
 
     void Update();
-    void HandleInput();
     void UpdateUI();
 
     void Draw();
     void DrawUI();
 
+    bool StartReplay(const std::string& path);
+    void SetGravity(int gravity);
+    void SetBotBeam(int width, int depth);
+    void SetBotRollouts(int depth, int count, double budgetSeconds);
+    void SaveReplayToFile();
+
     void CheckForHighScore();
     void SaveHighScoreToFile();
     int LoadHighScoreFromFile();
 
-    std::string FormatWithLeadingZeroes(int number, int width);
+    const char* FormatWithLeadingZeroes(int number, int width);
+
+    void SetAllocBudget(int64_t maxAllocsPerFrame);
+    bool IsAllocBudgetExceeded() const;
+    bool ExportAllocStats(const std::string& path) const;
 
     bool firstTimeGameStart;
     bool isFirstFrameAfterReset;
@@ -52,56 +64,46 @@ public:
     Color arrowColor;
 
 private:
-    Block GetRandomBlock();
-    std::vector<Block> GetAllBlocks();
-    bool IsBlockOutside();
-    bool IsBlockOutside(Block block);
-    void TryToMoveBlockInside();
-    bool RotateBlock();
-    void LockBlock();
-    void UpdateScore(int clearedRows);
-    bool BlockFits();
-    bool BlockFits(Block block);
-
-    bool MoveBlockLeft();
-    bool MoveBlockLeftRepeat(int count);
-    bool MoveBlockRight();
-    bool MoveBlockRightRepeat(int count);
-    bool MoveBlockUpRepeat(int count);
-    void MoveBlockDown();
-    void HardDropBlock();
-    void SnakeDropBlock();
-    bool CheckBlockInAir();
+    EngineInput HandleInput();
+    void HandleEngineEvents(const EngineEvents& events);
     Sound rotateSound;
     Sound clearSound;
     Sound dropSound;
     Sound lockSound;
     Music backgroundMusic;
-    Grid grid;
+    Engine engine;
+    double tickAccumulator;
+    const double tickTime = 1.0 / ticksPerSecond;
+    const double maxFrameTime = 0.25; // don't try to catch up after long stalls
+    int gravity; // fixed gravity for new games in 1/256 rows per tick, 0 follows the level
 
-    std::vector<Block> blocks;
-    Block currentBlock;
-    Block nextBlock;
+    // every game is recorded, a loaded replay drives the engine instead of the keys
+    Replay replay;
+    ReplayPlayer replayPlayer;
+    bool replayPlayback;
     Font font;
-    int score;
     int highScore;
 
-    // input stuff
-    float lastInputTime;
-    float lastRotateInputTime;
-    float lastDropAfterSpawnTime;
-    bool lockBlock;
-    bool firstDrop;
-    float lockBlockTimer;
-    const float blockLockTime = 0.3f;
-    int lockStateMoves;
-    const int maxLockStateMoves = 5;
-    int currentLevel;
-    const int startingLevel = 1;
-    const int maxScore = 10000;
-    const float inputDelay = 0.1f;
-    const float rotateInputDelay = 0.2f;
-    const float dropAfterSpawnDelay = 0.3f;
+    // B hands the keys to the bot, its inputs are recorded like a player's
+    Bot bot;
+    bool botEnabled;
+
+    // R scrubs back through the last minute of play, T forward again. Play
+    // resumes from wherever the scrub stopped and the rest is dropped.
+    RewindBuffer rewind;
+    bool scrubbing;
+    double scrubTick;
+    const double scrubSpeed = 2.0; // ticks scrubbed per simulated tick
+    void Scrub(int direction);
+    void EndScrub();
+
+    // heap allocations per frame, F3 shows them, a budget of -1 is unchecked
+    FrameAllocStats allocStats;
+    bool showAllocStats;
+    int64_t allocBudget;
+    bool allocBudgetExceeded;
+    void CheckAllocBudget();
+    void DrawAllocStats();
 
     float screenScale;
     RenderTexture2D targetRenderTex;
@@ -115,6 +117,5 @@ private:
 
     bool exitWindowRequested;
 
-    Block GetGhostPiece();
     void DrawGhostPiece();
 };
\ No newline at end of file
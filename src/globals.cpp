@@ -25,9 +25,12 @@ const Color cyan = {21, 204, 209, 255};
 const Color blue = {13, 64, 216, 255};
 const Color lightBlue = {59, 85, 162, 255};
 const Color darkBlue = {44, 44, 127, 255};
+const Color garbageGrey = {110, 110, 110, 255};
 const int gridThickness = 2;
 
+const Color cellColors[] = {darkGrey, green, red, orange, yellow, purple, cyan, blue, garbageGrey};
+
 std::vector<Color> GetCellColors()
 {
-    return {darkGrey, green, red, orange, yellow, purple, cyan, blue};
+    return std::vector<Color>(cellColors, cellColors + sizeof(cellColors) / sizeof(cellColors[0]));
 }
\ No newline at end of file
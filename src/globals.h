@@ -32,5 +32,7 @@ extern const Color cyan;
 extern const Color blue;
 extern const Color lightBlue;
 extern const Color darkBlue;
+extern const Color garbageGrey;
 
+extern const Color cellColors[];
 extern std::vector<Color> GetCellColors();
\ No newline at end of file
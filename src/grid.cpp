@@ -1,150 +1,147 @@
 #include "grid.h"
-#include "globals.h"
 
+template class BasicGrid<defNumRows, defNumCols>;
 
-Grid::Grid()
+DynamicGrid::DynamicGrid(int numRows, int numCols)
 {
-    numRows = defNumRows;
-    numCols = defNumCols;
-    cellSize = defCellSize;
-    colors = GetCellColors();
+    this->numRows = std::max(numRows, 1);
+    this->numCols = std::min(std::max(numCols, 1), 64);
+    fullRowMask = this->numCols == 64 ? ~0ull : (1ull << this->numCols) - 1;
     Initialize();
 }
 
-void Grid::Initialize()
+void DynamicGrid::Initialize()
 {
-    // Clear the grid
-    for (int row = 0; row < numRows; row++)
-    {
-        for (int col = 0; col < numCols; col++)
-        {
-            grid[row][col] = 0;
-        }
-    }
+    cells.assign((size_t)numRows * numCols, 0);
+    rowMasks.assign(numRows, 0);
 }
 
-void Grid::Print()
+bool DynamicGrid::IsValidPosition(int row, int col) const
 {
-    for (int row = 0; row < numRows; row++)
-    {
-        for (int col = 0; col < numCols; col++)
-        {
-            std::cout << grid[row][col] << " ";
-        }
-        std::cout << "\n";
-    }
+    return row >= 0 && row < numRows && col >= 0 && col < numCols;
 }
 
-void Grid::Draw()
+bool DynamicGrid::IsCellEmpty(int row, int column) const
 {
-    // Draw the grid cells
-    for (int row = 0; row < numRows; row++)
-    {
-        for (int col = 0; col < numCols; col++)
-        {
-            int cellValue = grid[row][col]; 
-            DrawRectangle(col * cellSize + 11, row * cellSize + 11, cellSize - 1, cellSize - 1, colors[cellValue]);
-        }
+    if (!IsValidPosition(row, column)) {
+        return true; // Consider out-of-bounds cells as empty
     }
+    return (rowMasks[row] & (1ull << column)) == 0;
+}
 
-    // Draw grid lines
-    Color gridLineColor = {60, 60, 60, 255};
-    int lineThickness = gridThickness;
+void DynamicGrid::SetCell(int row, int column, int value)
+{
+    if (!IsValidPosition(row, column)) {
+        return;
+    }
 
-    // Draw vertical lines
-    for (int col = 0; col <= numCols; col++)
+    cells[(size_t)row * numCols + column] = (uint8_t)value;
+    if (value != 0)
     {
-        DrawRectangle(col * cellSize + 10, 11, lineThickness, numRows * cellSize, gridLineColor);
+        rowMasks[row] |= 1ull << column;
     }
-
-    // Draw horizontal lines
-    for (int row = 0; row <= numRows; row++)
+    else
     {
-        DrawRectangle(10, row * cellSize + 11, numCols * cellSize, lineThickness, gridLineColor);
+        rowMasks[row] &= ~(1ull << column);
     }
 }
 
-bool Grid::IsCellOutside(int row, int column)
+bool DynamicGrid::Fits(int row, int column, const uint16_t* shapeMasks, int numMasks) const
 {
-    if (row >= 0 && row < numRows && column >= 0 && column < numCols)
+    for (int i = 0; i < numMasks; i++)
     {
-        return false;
+        int gridRow = row + i;
+        if (shapeMasks[i] == 0 || gridRow < 0 || gridRow >= numRows || column >= numCols)
+        {
+            continue;
+        }
+
+        uint64_t mask = column >= 0 ? (uint64_t)shapeMasks[i] << column : (uint64_t)shapeMasks[i] >> -column;
+        if (rowMasks[gridRow] & mask)
+        {
+            return false;
+        }
     }
     return true;
 }
 
-bool Grid::IsValidPosition(int row, int col) const
+bool DynamicGrid::BlockFits(const Block& block) const
 {
-    return row >= 0 && row < numRows && col >= 0 && col < numCols;
+    return Fits(block.GetRowOffset(), block.GetColumnOffset(), block.GetRotation().rowMasks, 4);
 }
 
-bool Grid::IsCellEmpty(int row, int column)
+bool DynamicGrid::IsBlockOutside(const Block& block) const
 {
-    if (!IsValidPosition(row, column)) {
-        return true; // Consider out-of-bounds cells as empty
+    const BlockRotation& rotation = block.GetRotation();
+    int row = block.GetRowOffset();
+    int column = block.GetColumnOffset();
+    return row + rotation.minRow < 0 || row + rotation.maxRow >= numRows ||
+           column + rotation.minColumn < 0 || column + rotation.maxColumn >= numCols;
+}
+
+void DynamicGrid::PlaceBlock(const Block& block)
+{
+    BlockCells tiles = block.GetCellPositions();
+    for (Position item : tiles)
+    {
+        SetCell(item.row, item.column, block.id);
     }
-    return grid[row][column] == 0;
 }
 
-int Grid::ClearFullRows()
+int DynamicGrid::DropDistance(const Block& block) const
 {
-    int completed = 0;
+    Block test = block;
+    int distance = 0;
+    while (true)
+    {
+        test.Move(1, 0);
+        if (IsBlockOutside(test) || BlockFits(test) == false)
+        {
+            return distance;
+        }
+        distance++;
+    }
+}
 
+int DynamicGrid::ClearFullRows()
+{
+    int completed = 0;
     for (int row = numRows - 1; row >= 0; row--)
     {
-        if (IsRowFull(row))
+        uint8_t* rowCells = &cells[(size_t)row * numCols];
+        if (rowMasks[row] == fullRowMask)
         {
-            ClearRow(row);
+            std::fill(rowCells, rowCells + numCols, (uint8_t)0);
+            rowMasks[row] = 0;
             completed++;
         }
-        else if (completed > 0)
+        else if (completed > 0 && rowMasks[row] != 0)
         {
-            MoveRowDown(row, completed);
+            std::copy(rowCells, rowCells + numCols, &cells[(size_t)(row + completed) * numCols]);
+            std::fill(rowCells, rowCells + numCols, (uint8_t)0);
+            rowMasks[row + completed] = rowMasks[row];
+            rowMasks[row] = 0;
         }
     }
-
     return completed;
 }
 
-int Grid::GetNumCols()
+int DynamicGrid::GetCell(int row, int column) const
 {
-    return numCols;
+    return cells[(size_t)row * numCols + column];
 }
 
-int Grid::GetNumRows()
+uint64_t DynamicGrid::GetRowMask(int row) const
 {
-    return numRows;
+    return rowMasks[row];
 }
 
-bool Grid::IsRowFull(int row)
+int DynamicGrid::GetNumCols() const
 {
-    for (int column = 0; column < numCols; column++)
-    {
-        if (grid[row][column] == 0)
-        {
-            return false;
-        }
-    }
-    return true;
-}
-
-void Grid::ClearRow(int row)
-{
-    for (int column = 0; column < numCols; column++)
-    {
-        grid[row][column] = 0;
-    }
+    return numCols;
 }
 
-void Grid::MoveRowDown(int row, int numRowsToMove)
+int DynamicGrid::GetNumRows() const
 {
-    if (!IsValidPosition(row, 0) || !IsValidPosition(row + numRowsToMove, 0)) {
-        return; // Don't move if source or destination is out of bounds
-    }
-    
-    for (int column = 0; column < numCols; column++)
-    {
-        grid[row + numRowsToMove][column] = grid[row][column];
-        grid[row][column] = 0;
-    }
+    return numRows;
 }
@@ -1,35 +1,580 @@
 #pragma once
 
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
 #include <iostream>
+#include <type_traits>
 #include <vector>
-#include <raylib.h>
+#include "block.h"
+#include "zobrist.h"
 
 
 const int defNumRows = 20;
 const int defNumCols = 10;
 const int defCellSize = 30;
 
-class Grid
+// Cell value of garbage rows, one past the last block id
+const int garbageCellId = numBlockTypes + 1;
+
+// Narrowest unsigned type with one bit per column
+template <int Cols>
+struct GridRowMask
+{
+    static_assert(Cols > 0 && Cols <= 64, "grids are at most 64 columns wide");
+    typedef typename std::conditional<Cols <= 16, uint16_t,
+            typename std::conditional<Cols <= 32, uint32_t, uint64_t>::type>::type type;
+};
+
+// Board with its size fixed at compile time, so every row and column loop has
+// constant bounds the compiler can unroll. Grid below is the standard 10x20
+// board, DynamicGrid covers sizes only known at run time.
+template <int Rows, int Cols>
+class BasicGrid
 {
     public:
-        Grid();
+        typedef typename GridRowMask<Cols>::type RowMask;
+
+        // Occupancy mask of a completely filled row, one bit per column
+        static constexpr RowMask fullRowMask = (RowMask)(Cols == 64 ? ~0ull : (1ull << (Cols % 64)) - 1);
+
+        BasicGrid();
         void Initialize();
-        void Print();
-        void Draw();
-        bool IsCellOutside(int row, int column);
-        bool IsCellEmpty(int row, int column);
+        void Print() const;
+        void Draw() const;
+        bool IsCellOutside(int row, int column) const;
+        bool IsCellEmpty(int row, int column) const;
+        void SetCell(int row, int column, int value);
+        bool Fits(int row, int column, const uint16_t* shapeMasks, int numMasks) const;
+        bool BlockFits(const Block& block) const;
+        bool IsBlockOutside(const Block& block) const;
+        int FindFittingOffset(const Block& block, const Position* offsets, int numOffsets) const;
+        void PlaceBlock(const Block& block);
+        int DropDistance(const Block& block) const;
         int ClearFullRows();
-        int grid[defNumRows][defNumCols];
-        int GetNumCols();
-        int GetNumRows();
+        bool AddGarbageRows(int count, int holeColumn);
+        int GetCell(int row, int column) const;
+        RowMask GetRowMask(int row) const;
+        const RowMask* GetRowMasks() const;
+        static constexpr int GetNumCols() { return Cols; }
+        static constexpr int GetNumRows() { return Rows; }
+        const int* GetColumnHeights() const;
+        int GetColumnHeight(int column) const;
+        int GetRowFillCount(int row) const;
+        uint64_t GetHash() const;
 
     private:
-        bool IsRowFull(int row);
+        bool IsRowFull(int row) const;
         void ClearRow(int row);
         void MoveRowDown(int row, int numRows);
+        void CopyRow(int fromRow, int toRow);
+        int RowSlot(int row) const;
+        void SetRowMask(int row, RowMask mask);
+        bool IsValidPosition(int row, int col) const;
+        void UpdateColumnHeight(int column, int fromRow);
+        void UpdateColumnHeights();
+
+        // Rows live in a ring: row r is stored in slot (topSlot + r) % Rows, so
+        // clearing rows or pushing garbage rotates topSlot instead of moving the board.
+        // The masks are stored twice in a row so rowMasks + topSlot reads as a plain array.
+        int topSlot;
+        uint8_t cells[Rows][Cols];
+        RowMask rowMasks[2 * Rows];
+        int columnHeights[Cols]; // filled height of each column, 0 when empty
+        uint64_t hash;           // Zobrist hash of the filled cells, the colours do not count
+};
+
+typedef BasicGrid<defNumRows, defNumCols> Grid;
+
+// Occupancy mask of a completely filled standard row
+const uint16_t fullRowMask = Grid::fullRowMask;
+
+// Runtime-sized board for custom and stress sizes, up to 64 columns. It keeps
+// the plain row-major layout and steps row by row, so it is the baseline the
+// fixed-size grids are measured against rather than something the engine uses.
+class DynamicGrid
+{
+    public:
+        DynamicGrid(int numRows, int numCols);
+        void Initialize();
+        bool IsCellEmpty(int row, int column) const;
+        void SetCell(int row, int column, int value);
+        bool Fits(int row, int column, const uint16_t* shapeMasks, int numMasks) const;
+        bool BlockFits(const Block& block) const;
+        bool IsBlockOutside(const Block& block) const;
+        void PlaceBlock(const Block& block);
+        int DropDistance(const Block& block) const;
+        int ClearFullRows();
+        int GetCell(int row, int column) const;
+        uint64_t GetRowMask(int row) const;
+        int GetNumCols() const;
+        int GetNumRows() const;
+
+    private:
         bool IsValidPosition(int row, int col) const;
         int numRows;
         int numCols;
-        int cellSize;
-        std::vector<Color> colors;
-};
\ No newline at end of file
+        uint64_t fullRowMask;
+        std::vector<uint8_t> cells;
+        std::vector<uint64_t> rowMasks;
+};
+
+template <int Rows, int Cols>
+BasicGrid<Rows, Cols>::BasicGrid()
+{
+    Initialize();
+}
+
+template <int Rows, int Cols>
+void BasicGrid<Rows, Cols>::Initialize()
+{
+    // Clear the grid
+    topSlot = 0;
+    for (int row = 0; row < Rows; row++)
+    {
+        ClearRow(row);
+    }
+    for (int col = 0; col < Cols; col++)
+    {
+        columnHeights[col] = 0;
+    }
+    hash = 0;
+}
+
+template <int Rows, int Cols>
+void BasicGrid<Rows, Cols>::Print() const
+{
+    for (int row = 0; row < Rows; row++)
+    {
+        for (int col = 0; col < Cols; col++)
+        {
+            std::cout << GetCell(row, col) << " ";
+        }
+        std::cout << "\n";
+    }
+}
+
+template <int Rows, int Cols>
+bool BasicGrid<Rows, Cols>::IsCellOutside(int row, int column) const
+{
+    return IsValidPosition(row, column) == false;
+}
+
+template <int Rows, int Cols>
+bool BasicGrid<Rows, Cols>::IsValidPosition(int row, int col) const
+{
+    return row >= 0 && row < Rows && col >= 0 && col < Cols;
+}
+
+template <int Rows, int Cols>
+bool BasicGrid<Rows, Cols>::IsCellEmpty(int row, int column) const
+{
+    if (!IsValidPosition(row, column)) {
+        return true; // Consider out-of-bounds cells as empty
+    }
+    return (GetRowMask(row) & ((RowMask)1 << column)) == 0;
+}
+
+template <int Rows, int Cols>
+void BasicGrid<Rows, Cols>::SetCell(int row, int column, int value)
+{
+    if (!IsValidPosition(row, column)) {
+        return;
+    }
+
+    // Keep the colour plane, the occupancy bitboard and the hash in sync
+    if (((GetRowMask(row) >> column) & 1) != (value != 0))
+    {
+        hash ^= zobristCellKeys<Rows, Cols>.cells[row][column];
+    }
+    cells[RowSlot(row)][column] = (uint8_t)value;
+    if (value != 0)
+    {
+        SetRowMask(row, GetRowMask(row) | ((RowMask)1 << column));
+        columnHeights[column] = std::max(columnHeights[column], Rows - row);
+    }
+    else
+    {
+        SetRowMask(row, GetRowMask(row) & ~((RowMask)1 << column));
+        if (columnHeights[column] == Rows - row)
+        {
+            UpdateColumnHeight(column, row + 1);
+        }
+    }
+}
+
+template <int Rows, int Cols>
+bool BasicGrid<Rows, Cols>::Fits(int row, int column, const uint16_t* shapeMasks, int numMasks) const
+{
+    // shapeMasks[i] holds the cells of shape row i, bit 0 being the shape's leftmost column.
+    // Cells that fall outside the grid count as empty, same as IsCellEmpty.
+    const RowMask* masks = rowMasks + topSlot;
+    for (int i = 0; i < numMasks; i++)
+    {
+        int gridRow = row + i;
+        if (shapeMasks[i] == 0 || gridRow < 0 || gridRow >= Rows || column >= Cols)
+        {
+            continue;
+        }
+
+        RowMask mask = column >= 0 ? (RowMask)((RowMask)shapeMasks[i] << column) : (RowMask)(shapeMasks[i] >> -column);
+        if (masks[gridRow] & mask)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <int Rows, int Cols>
+bool BasicGrid<Rows, Cols>::BlockFits(const Block& block) const
+{
+    // Blocks always span four mask rows, a constant the compiler unrolls Fits for
+    return Fits(block.GetRowOffset(), block.GetColumnOffset(), block.GetRotation().rowMasks, 4);
+}
+
+template <int Rows, int Cols>
+bool BasicGrid<Rows, Cols>::IsBlockOutside(const Block& block) const
+{
+    const BlockRotation& rotation = block.GetRotation();
+    int row = block.GetRowOffset();
+    int column = block.GetColumnOffset();
+    return row + rotation.minRow < 0 || row + rotation.maxRow >= Rows ||
+           column + rotation.minColumn < 0 || column + rotation.maxColumn >= Cols;
+}
+
+template <int Rows, int Cols>
+int BasicGrid<Rows, Cols>::FindFittingOffset(const Block& block, const Position* offsets, int numOffsets) const
+{
+    // Index of the first offset that puts the block inside the board and clear of
+    // the stack, or -1. Bounds and masks are tested together for each offset.
+    const BlockRotation& rotation = block.GetRotation();
+    for (int i = 0; i < numOffsets; i++)
+    {
+        int row = block.GetRowOffset() + offsets[i].row;
+        int column = block.GetColumnOffset() + offsets[i].column;
+        if (row + rotation.minRow >= 0 && row + rotation.maxRow < Rows &&
+            column + rotation.minColumn >= 0 && column + rotation.maxColumn < Cols &&
+            Fits(row, column, rotation.rowMasks, 4))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+template <int Rows, int Cols>
+void BasicGrid<Rows, Cols>::PlaceBlock(const Block& block)
+{
+    BlockCells tiles = block.GetCellPositions();
+    for (Position item : tiles)
+    {
+        SetCell(item.row, item.column, block.id);
+    }
+}
+
+template <int Rows, int Cols>
+int BasicGrid<Rows, Cols>::DropDistance(const Block& block) const
+{
+    // When every column of the block is above the skyline the landing row
+    // comes straight from the column heights
+    const BlockRotation& rotation = block.GetRotation();
+    int row = block.GetRowOffset();
+    int column = block.GetColumnOffset();
+    int distance = Rows;
+    bool aboveSkyline = true;
+    for (int i = 0; i < 4; i++)
+    {
+        if (rotation.columnBottoms[i] < 0)
+        {
+            continue;
+        }
+        int gridColumn = column + i;
+        int surfaceRow = Rows - (IsValidPosition(0, gridColumn) ? columnHeights[gridColumn] : 0);
+        int bottomRow = row + rotation.columnBottoms[i];
+        if (bottomRow >= surfaceRow)
+        {
+            aboveSkyline = false;
+            break;
+        }
+        distance = std::min(distance, surfaceRow - 1 - bottomRow);
+    }
+    if (aboveSkyline)
+    {
+        return distance;
+    }
+
+    // Tucked under an overhang, step down row by row
+    Block test = block;
+    distance = 0;
+    while (true)
+    {
+        test.Move(1, 0);
+        if (IsBlockOutside(test) || BlockFits(test) == false)
+        {
+            return distance;
+        }
+        distance++;
+    }
+}
+
+template <int Rows, int Cols>
+int BasicGrid<Rows, Cols>::ClearFullRows()
+{
+    int completed = 0;
+    int topFullRow = -1;
+    int bottomFullRow = -1;
+    for (int row = 0; row < Rows; row++)
+    {
+        if (IsRowFull(row))
+        {
+            if (topFullRow < 0)
+            {
+                topFullRow = row;
+            }
+            bottomFullRow = row;
+            completed++;
+        }
+    }
+    if (completed == 0)
+    {
+        return 0;
+    }
+
+    // Only the rows down to the lowest full one change, their cells are hashed
+    // out here and the rows that end up there are hashed back in below
+    for (int row = 0; row <= bottomFullRow; row++)
+    {
+        hash ^= ZobristRowHash<Rows, Cols>(row, GetRowMask(row));
+    }
+
+    // Either the stack above the full rows moves down, or the rows below them move
+    // up and the freed slots rotate round to become the top rows. Clears at the
+    // bottom of the board take the second way and copy nothing at all.
+    int rowsAbove = 0;
+    for (int row = 0; row < bottomFullRow; row++)
+    {
+        if (GetRowMask(row) != 0 && IsRowFull(row) == false)
+        {
+            rowsAbove++;
+        }
+    }
+    int rowsBelow = Rows - topFullRow - completed;
+
+    if (rowsBelow <= rowsAbove)
+    {
+        int destination = topFullRow;
+        for (int row = topFullRow; row < Rows; row++)
+        {
+            if (IsRowFull(row) == false)
+            {
+                CopyRow(row, destination);
+                destination++;
+            }
+        }
+        for (int row = destination; row < Rows; row++)
+        {
+            ClearRow(row);
+        }
+        topSlot = RowSlot(Rows - completed);
+    }
+    else
+    {
+        int cleared = 0;
+        for (int row = bottomFullRow; row >= 0; row--)
+        {
+            if (IsRowFull(row))
+            {
+                ClearRow(row);
+                cleared++;
+            }
+            else if (cleared > 0 && GetRowMask(row) != 0)
+            {
+                MoveRowDown(row, cleared);
+            }
+        }
+    }
+
+    for (int row = 0; row <= bottomFullRow; row++)
+    {
+        hash ^= ZobristRowHash<Rows, Cols>(row, GetRowMask(row));
+    }
+    UpdateColumnHeights();
+    return completed;
+}
+
+template <int Rows, int Cols>
+bool BasicGrid<Rows, Cols>::AddGarbageRows(int count, int holeColumn)
+{
+    // Pushes count rows in from the bottom, filled apart from holeColumn.
+    // Returns false when cells were pushed out of the top of the grid.
+    count = std::min(count, Rows);
+    if (count <= 0)
+    {
+        return true;
+    }
+
+    bool fits = true;
+    for (int row = 0; row < count; row++)
+    {
+        if (GetRowMask(row) != 0)
+        {
+            fits = false;
+        }
+    }
+
+    // The top rows are recycled as the new bottom rows
+    topSlot = RowSlot(count);
+    RowMask garbageMask = IsValidPosition(0, holeColumn) ? (RowMask)(fullRowMask & ~((RowMask)1 << holeColumn)) : fullRowMask;
+    for (int row = Rows - count; row < Rows; row++)
+    {
+        uint8_t* rowCells = cells[RowSlot(row)];
+        for (int column = 0; column < Cols; column++)
+        {
+            rowCells[column] = (garbageMask & ((RowMask)1 << column)) ? (uint8_t)garbageCellId : 0;
+        }
+        SetRowMask(row, garbageMask);
+    }
+
+    // Every row moved up, the hash is made again from scratch
+    hash = 0;
+    for (int row = 0; row < Rows; row++)
+    {
+        hash ^= ZobristRowHash<Rows, Cols>(row, GetRowMask(row));
+    }
+    UpdateColumnHeights();
+    return fits;
+}
+
+template <int Rows, int Cols>
+int BasicGrid<Rows, Cols>::GetCell(int row, int column) const
+{
+    return cells[RowSlot(row)][column];
+}
+
+template <int Rows, int Cols>
+typename BasicGrid<Rows, Cols>::RowMask BasicGrid<Rows, Cols>::GetRowMask(int row) const
+{
+    return rowMasks[topSlot + row];
+}
+
+template <int Rows, int Cols>
+const typename BasicGrid<Rows, Cols>::RowMask* BasicGrid<Rows, Cols>::GetRowMasks() const
+{
+    return rowMasks + topSlot;
+}
+
+template <int Rows, int Cols>
+const int* BasicGrid<Rows, Cols>::GetColumnHeights() const
+{
+    return columnHeights;
+}
+
+template <int Rows, int Cols>
+int BasicGrid<Rows, Cols>::GetColumnHeight(int column) const
+{
+    return columnHeights[column];
+}
+
+template <int Rows, int Cols>
+int BasicGrid<Rows, Cols>::GetRowFillCount(int row) const
+{
+    // The occupancy mask already counts the row, no separate array to keep in sync
+    return (int)std::bitset<Cols>((unsigned long long)GetRowMask(row)).count();
+}
+
+template <int Rows, int Cols>
+uint64_t BasicGrid<Rows, Cols>::GetHash() const
+{
+    return hash;
+}
+
+template <int Rows, int Cols>
+bool BasicGrid<Rows, Cols>::IsRowFull(int row) const
+{
+    return GetRowMask(row) == fullRowMask;
+}
+
+template <int Rows, int Cols>
+void BasicGrid<Rows, Cols>::ClearRow(int row)
+{
+    std::fill(cells[RowSlot(row)], cells[RowSlot(row)] + Cols, (uint8_t)0);
+    SetRowMask(row, 0);
+}
+
+template <int Rows, int Cols>
+void BasicGrid<Rows, Cols>::MoveRowDown(int row, int numRowsToMove)
+{
+    if (!IsValidPosition(row, 0) || !IsValidPosition(row + numRowsToMove, 0)) {
+        return; // Don't move if source or destination is out of bounds
+    }
+
+    CopyRow(row, row + numRowsToMove);
+    ClearRow(row);
+}
+
+template <int Rows, int Cols>
+void BasicGrid<Rows, Cols>::CopyRow(int fromRow, int toRow)
+{
+    std::copy(cells[RowSlot(fromRow)], cells[RowSlot(fromRow)] + Cols, cells[RowSlot(toRow)]);
+    SetRowMask(toRow, GetRowMask(fromRow));
+}
+
+template <int Rows, int Cols>
+int BasicGrid<Rows, Cols>::RowSlot(int row) const
+{
+    int slot = topSlot + row;
+    return slot >= Rows ? slot - Rows : slot;
+}
+
+template <int Rows, int Cols>
+void BasicGrid<Rows, Cols>::SetRowMask(int row, RowMask mask)
+{
+    int slot = RowSlot(row);
+    rowMasks[slot] = mask;
+    rowMasks[slot + Rows] = mask;
+}
+
+template <int Rows, int Cols>
+void BasicGrid<Rows, Cols>::UpdateColumnHeight(int column, int fromRow)
+{
+    // The rows above fromRow are known to be empty in this column
+    columnHeights[column] = 0;
+    const RowMask* masks = rowMasks + topSlot;
+    for (int row = fromRow; row < Rows; row++)
+    {
+        if (masks[row] & ((RowMask)1 << column))
+        {
+            columnHeights[column] = Rows - row;
+            break;
+        }
+    }
+}
+
+template <int Rows, int Cols>
+void BasicGrid<Rows, Cols>::UpdateColumnHeights()
+{
+    // One pass from the top, each column takes the height of the first row that fills it
+    RowMask remaining = fullRowMask;
+    const RowMask* masks = rowMasks + topSlot;
+    for (int col = 0; col < Cols; col++)
+    {
+        columnHeights[col] = 0;
+    }
+    for (int row = 0; row < Rows && remaining != 0; row++)
+    {
+        RowMask newlyFilled = masks[row] & remaining;
+        for (int col = 0; newlyFilled != 0; col++)
+        {
+            if (newlyFilled & ((RowMask)1 << col))
+            {
+                columnHeights[col] = Rows - row;
+                newlyFilled &= ~((RowMask)1 << col);
+            }
+        }
+        remaining &= ~masks[row];
+    }
+}
+
+// The standard board is compiled once, in grid.cpp
+extern template class BasicGrid<defNumRows, defNumCols>;
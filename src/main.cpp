@@ -1,7 +1,10 @@
 #include <raylib.h>
 #include "globals.h"
 #include "game.h"
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
+#include <string>
 
 #ifdef EMSCRIPTEN_BUILD
 #include <emscripten.h>
@@ -18,7 +21,7 @@ void MainLoop(void* arg)
     gamePtr->Draw();
 }
 
-int main()
+int main(int argc, char** argv)
 {
     InitWindow(gameScreenWidth, gameScreenHeight, "Tetris");
 #ifndef EMSCRIPTEN_BUILD
@@ -45,16 +48,76 @@ int main()
         return 1;
     }
     game->InitializeResources();
+
+    // tetris --replay <file> plays a recorded game back in real time.
+    // --alloc-budget <n> quits with an error once a frame makes more than n heap
+    // allocations, --alloc-frames <n> quits after n frames and --alloc-export <file>
+    // writes the per phase counts on exit, so a replay run can gate allocations.
+    // --gravity <g> plays at a fixed gravity in rows per tick, 20 is 20G.
+    // --beam <width>,<depth> makes the bot (B) look depth pieces ahead.
+    // --rollouts <depth>,<count>[,<ms>] makes it play count games of depth pieces
+    // after each placement on every core, for at most ms per move.
+    long maxFrames = -1;
+    string allocExportPath;
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--replay" && !game->StartReplay(argv[i + 1]))
+        {
+            cout << "Failed to load replay " << argv[i + 1] << "\n";
+        }
+        else if (arg == "--gravity")
+        {
+            game->SetGravity((int)(atof(argv[i + 1]) * gravityUnit));
+        }
+        else if (arg == "--beam")
+        {
+            int width = 0;
+            int depth = 0;
+            if (sscanf(argv[i + 1], "%d,%d", &width, &depth) == 2)
+            {
+                game->SetBotBeam(width, depth);
+            }
+        }
+        else if (arg == "--rollouts")
+        {
+            int depth = 0;
+            int count = defaultRolloutCount;
+            double budgetMs = 0.0;
+            if (sscanf(argv[i + 1], "%d,%d,%lf", &depth, &count, &budgetMs) >= 2)
+            {
+                game->SetBotRollouts(depth, count, budgetMs / 1e3);
+            }
+        }
+        else if (arg == "--alloc-budget")
+        {
+            game->SetAllocBudget(atoll(argv[i + 1]));
+        }
+        else if (arg == "--alloc-frames")
+        {
+            maxFrames = atol(argv[i + 1]);
+        }
+        else if (arg == "--alloc-export")
+        {
+            allocExportPath = argv[i + 1];
+        }
+    }
  
 #ifdef EMSCRIPTEN_BUILD
     emscripten_set_main_loop_arg(MainLoop, game, 0, 1);
 #else
-    while (!WindowShouldClose() && !exitWindow)
+    for (long frame = 0; !WindowShouldClose() && !exitWindow && frame != maxFrames; frame++)
     {
         MainLoop(game);
     }
 #endif
 
+    if (!allocExportPath.empty() && !game->ExportAllocStats(allocExportPath))
+    {
+        cout << "Failed to write allocation stats to " << allocExportPath << "\n";
+    }
+    int exitCode = game->IsAllocBudgetExceeded() ? 1 : 0;
+
     CloseAudioDevice();
     CloseWindow();
 
@@ -62,5 +125,5 @@ int main()
         delete game;
         game = nullptr;
     }
-    return 0;
+    return exitCode;
 }
\ No newline at end of file
@@ -0,0 +1,240 @@
+#include "movegen.h"
+
+EngineInput PieceMoveToInput(PieceMove move)
+{
+    // There is no key for a single row down, the player waits for gravity
+    EngineInput input = {false, false, false, false, false};
+    input.left = move == MoveLeft;
+    input.right = move == MoveRight;
+    input.rotate = move == MoveRotate;
+    input.softDrop = move == MoveSoftDrop;
+    return input;
+}
+
+// Rotation states whose cells are the same shape map to the first of them, so
+// resting positions can be compared by shape and bounding box alone
+struct ShapeClasses
+{
+    int classes[numBlockTypes + 1][numRotations];
+
+    ShapeClasses()
+    {
+        for (int id = 0; id <= numBlockTypes; id++)
+        {
+            for (int rotation = 0; rotation < numRotations; rotation++)
+            {
+                classes[id][rotation] = rotation;
+                for (int earlier = rotation - 1; earlier >= 0; earlier--)
+                {
+                    if (SameShape(blockShapes[id].rotations[earlier], blockShapes[id].rotations[rotation]))
+                    {
+                        classes[id][rotation] = classes[id][earlier];
+                    }
+                }
+            }
+        }
+    }
+
+    static bool SameShape(const BlockRotation& a, const BlockRotation& b)
+    {
+        if (a.maxRow - a.minRow != b.maxRow - b.minRow)
+        {
+            return false;
+        }
+        for (int row = 0; row + a.minRow <= a.maxRow; row++)
+        {
+            if ((a.rowMasks[a.minRow + row] >> a.minColumn) != (b.rowMasks[b.minRow + row] >> b.minColumn))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+static const ShapeClasses shapeClasses;
+
+static_assert(MoveGenerator::stateRows <= 32, "fitting rows are kept in a uint32_t");
+static_assert(MoveGenerator::numStates <= UINT16_MAX, "states are queued as uint16_t");
+
+static int StateIndex(int rotation, int row, int column)
+{
+    return (rotation * MoveGenerator::stateRows + row + MoveGenerator::stateMargin) * MoveGenerator::stateColumns +
+           column + MoveGenerator::stateMargin;
+}
+
+MoveGenerator::MoveGenerator()
+{
+    queueLength = 0;
+    numPlacements = 0;
+}
+
+void MoveGenerator::FindFittingRows(const Grid& grid, int id)
+{
+    const Grid::RowMask* masks = grid.GetRowMasks();
+    for (int rotation = 0; rotation < numRotations; rotation++)
+    {
+        const BlockRotation& shape = blockShapes[id].rotations[rotation];
+        for (int column = -stateMargin; column < defNumCols; column++)
+        {
+            // Bottom up, so each fitting row can take the landing row of the one below it
+            uint32_t rows = 0;
+            int8_t* landing = landingRows[rotation][column + stateMargin];
+            if (column + shape.minColumn >= 0 && column + shape.maxColumn < defNumCols)
+            {
+                Grid::RowMask shifted[4];
+                for (int i = 0; i < 4; i++)
+                {
+                    shifted[i] = (Grid::RowMask)(column >= 0 ? shape.rowMasks[i] << column : shape.rowMasks[i] >> -column);
+                }
+                for (int row = defNumRows - 1 - shape.maxRow; row >= -shape.minRow; row--)
+                {
+                    Grid::RowMask overlap = 0;
+                    for (int i = shape.minRow; i <= shape.maxRow; i++)
+                    {
+                        overlap |= masks[row + i] & shifted[i];
+                    }
+                    if (overlap == 0)
+                    {
+                        bool below = (rows >> (row + 1 + stateMargin)) & 1;
+                        landing[row + stateMargin] = (int8_t)(below ? landing[row + 1 + stateMargin] : row);
+                        rows |= 1u << (row + stateMargin);
+                    }
+                }
+            }
+            fittingRows[rotation][column + stateMargin] = rows;
+        }
+    }
+}
+
+bool MoveGenerator::Fits(int rotation, int row, int column) const
+{
+    // Rows and columns past the margin are outside the board for every shape
+    if (row < -stateMargin || row >= defNumRows || column < -stateMargin || column >= defNumCols)
+    {
+        return false;
+    }
+    return (fittingRows[rotation][column + stateMargin] >> (row + stateMargin)) & 1;
+}
+
+void MoveGenerator::Visit(int state, int parent, PieceMove move)
+{
+    if (visited[state])
+    {
+        return;
+    }
+    visited[state] = true;
+    parents[state] = (uint16_t)parent;
+    parentMoves[state] = move;
+    depths[state] = (uint16_t)(parent == state ? 0 : depths[parent] + 1);
+    queue[queueLength++] = (uint16_t)state;
+}
+
+int MoveGenerator::Generate(const Grid& grid, const Block& block)
+{
+    visited.reset();
+    placed.reset();
+    queueLength = 0;
+    numPlacements = 0;
+    if (grid.IsBlockOutside(block) || grid.BlockFits(block) == false)
+    {
+        return 0;
+    }
+
+    FindFittingRows(grid, block.id);
+    const KickTable& kicks = *blockShapes[block.id].kicks;
+    int start = StateIndex(block.GetRotationState(), block.GetRowOffset(), block.GetColumnOffset());
+
+    // Every state is queued once, so the queue doubles as the list of visited states
+    Visit(start, start, MoveDown);
+    for (int head = 0; head < queueLength; head++)
+    {
+        int state = queue[head];
+        int rotation = state / (stateRows * stateColumns);
+        int row = state / stateColumns % stateRows - stateMargin;
+        int column = state % stateColumns - stateMargin;
+
+        int distance = landingRows[rotation][column + stateMargin][row + stateMargin] - row;
+
+        // Breadth-first order dequeues the shortest path to a resting position first
+        if (distance == 0)
+        {
+            const BlockRotation& shape = blockShapes[block.id].rotations[rotation];
+            int cells = StateIndex(shapeClasses.classes[block.id][rotation], row + shape.minRow, column + shape.minColumn);
+            if (placed[cells] == false)
+            {
+                placed[cells] = true;
+                Block resting = block;
+                while (resting.GetRotationState() != rotation)
+                {
+                    resting.Rotate();
+                }
+                resting.Move(row - resting.GetRowOffset(), column - resting.GetColumnOffset());
+                placements[numPlacements++] = MovePlacement{resting, state, depths[state]};
+            }
+        }
+
+        if (Fits(rotation, row, column - 1))
+        {
+            Visit(StateIndex(rotation, row, column - 1), state, MoveLeft);
+        }
+        if (Fits(rotation, row, column + 1))
+        {
+            Visit(StateIndex(rotation, row, column + 1), state, MoveRight);
+        }
+
+        int turned = (rotation + 1) % numRotations;
+        for (int i = 0; i < kicks.numKicks; i++)
+        {
+            const Position& offset = kicks.offsets[rotation][i];
+            if (Fits(turned, row + offset.row, column + offset.column))
+            {
+                Visit(StateIndex(turned, row + offset.row, column + offset.column), state, MoveRotate);
+                break;
+            }
+        }
+
+        if (distance > 0)
+        {
+            Visit(StateIndex(rotation, row + 1, column), state, MoveDown);
+        }
+        if (distance > 1)
+        {
+            Visit(StateIndex(rotation, row + distance, column), state, MoveSoftDrop);
+        }
+    }
+    return numPlacements;
+}
+
+int MoveGenerator::GetNumPlacements() const
+{
+    return numPlacements;
+}
+
+const MovePlacement& MoveGenerator::GetPlacement(int index) const
+{
+    return placements[index];
+}
+
+int MoveGenerator::GetPath(int index, PieceMove* moves, int maxMoves) const
+{
+    // Walks the parents back to the start and writes the moves in playing order,
+    // returns the path length or -1 when it does not fit in maxMoves
+    const MovePlacement& placement = placements[index];
+    if (placement.pathLength > maxMoves)
+    {
+        return -1;
+    }
+    int state = placement.state;
+    for (int i = placement.pathLength - 1; i >= 0; i--)
+    {
+        moves[i] = parentMoves[state];
+        state = parents[state];
+    }
+    return placement.pathLength;
+}
+
+int MoveGenerator::GetStatesVisited() const
+{
+    return queueLength;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include "engine.h"
+
+// One step a player can make with the falling block. MoveDown is a single row,
+// what gravity does while the player waits; MoveSoftDrop lands the block like
+// the soft drop key does.
+enum PieceMove : uint8_t
+{
+    MoveLeft,
+    MoveRight,
+    MoveRotate,
+    MoveDown,
+    MoveSoftDrop,
+    numPieceMoves,
+};
+
+EngineInput PieceMoveToInput(PieceMove move);
+
+// A resting position the block can reach, with the state it was first reached in
+struct MovePlacement
+{
+    Block block;
+    int state;
+    int pathLength;
+};
+
+// Breadth-first search over every (rotation, row, column) the falling block can
+// reach with the moves above, rotations taking SRS kicks like Engine::RotateBlock.
+// Each resting position is returned once, even when several rotation states
+// cover the same cells (I, S, Z and O), together with the length of the shortest
+// path to it. The board is first reduced to one bitmask of fitting rows per
+// rotation and column, so every move during the search is a bit test. All
+// storage is part of the object: keep one per thread and reuse it.
+class MoveGenerator
+{
+public:
+    MoveGenerator();
+    int Generate(const Grid& grid, const Block& block);
+    int GetNumPlacements() const;
+    const MovePlacement& GetPlacement(int index) const;
+    int GetPath(int index, PieceMove* moves, int maxMoves) const;
+    int GetStatesVisited() const;
+
+    // States are indexed by rotation, then row and column offset shifted by stateMargin
+    static constexpr int stateMargin = 4;
+    static constexpr int stateColumns = defNumCols + stateMargin;
+    static constexpr int stateRows = defNumRows + stateMargin;
+    static constexpr int numStates = numRotations * stateRows * stateColumns;
+
+private:
+    void FindFittingRows(const Grid& grid, int id);
+    bool Fits(int rotation, int row, int column) const;
+    void Visit(int state, int parent, PieceMove move);
+
+    // bit row + stateMargin is set when the block fits at that row and column + stateMargin
+    uint32_t fittingRows[numRotations][stateColumns];
+    int8_t landingRows[numRotations][stateColumns][stateRows]; // where a fitting block comes to rest
+    std::bitset<numStates> visited;
+    std::bitset<numStates> placed;     // resting cells already returned, by shape and bounding box
+    uint16_t queue[numStates];
+    uint16_t parents[numStates];
+    PieceMove parentMoves[numStates];
+    uint16_t depths[numStates];
+    int queueLength;
+    MovePlacement placements[numStates];
+    int numPlacements;
+};
@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <unordered_set>
+#include "movegen.h"
+#include "perft.h"
+#include "transposition.h"
+
+// Boards are told apart by their occupied cells, the colours do not matter
+struct BoardKey
+{
+    Grid::RowMask rows[defNumRows];
+
+    bool operator==(const BoardKey& other) const
+    {
+        return std::equal(rows, rows + defNumRows, other.rows);
+    }
+};
+
+struct BoardKeyHash
+{
+    size_t operator()(const BoardKey& key) const
+    {
+        // FNV-1a over the row masks
+        uint64_t hash = 0xCBF29CE484222325ull;
+        for (int row = 0; row < defNumRows; row++)
+        {
+            hash = (hash ^ key.rows[row]) * 0x100000001B3ull;
+        }
+        return (size_t)hash;
+    }
+};
+
+typedef std::unordered_set<BoardKey, BoardKeyHash> BoardSet;
+
+// What one thread needs: a generator and a list of placements per depth, since
+// the generator's own results are overwritten by the next level down
+struct PerftWorker
+{
+    MoveGenerator generator;
+    std::vector<std::vector<Block>> levels;
+    BoardSet boards;
+    uint64_t leaves;
+    uint64_t nodes;
+    uint64_t tableProbes;
+    uint64_t tableHits;
+};
+
+static void CountSubtree(PerftWorker& worker, const Grid& grid, const int* pieces, int depth, bool countDistinct,
+                         TranspositionTable* table);
+
+static void SearchSubtree(PerftWorker& worker, const Grid& grid, const int* pieces, int depth, bool countDistinct,
+                          TranspositionTable* table)
+{
+    int numPlacements = worker.generator.Generate(grid, Block(pieces[0]));
+    worker.nodes += numPlacements;
+    if (depth == 1 && countDistinct == false)
+    {
+        worker.leaves += numPlacements;
+        return;
+    }
+
+    std::vector<Block>& placements = worker.levels[depth - 1];
+    placements.clear();
+    for (int i = 0; i < numPlacements; i++)
+    {
+        placements.push_back(worker.generator.GetPlacement(i).block);
+    }
+
+    for (const Block& block : placements)
+    {
+        Grid next = grid;
+        next.PlaceBlock(block);
+        next.ClearFullRows();
+        if (depth > 1)
+        {
+            CountSubtree(worker, next, pieces + 1, depth - 1, countDistinct, table);
+            continue;
+        }
+        worker.leaves++;
+        BoardKey key;
+        std::copy(next.GetRowMasks(), next.GetRowMasks() + defNumRows, key.rows);
+        worker.boards.insert(key);
+    }
+}
+
+static void CountSubtree(PerftWorker& worker, const Grid& grid, const int* pieces, int depth, bool countDistinct,
+                         TranspositionTable* table)
+{
+    // The pieces left follow from the depth, so the board, the depth and the
+    // piece to place are the whole position
+    if (table == nullptr || depth >= maxZobristDepth)
+    {
+        SearchSubtree(worker, grid, pieces, depth, countDistinct, table);
+        return;
+    }
+    uint64_t key = grid.GetHash() ^ zobristKeys.depths[depth] ^ zobristKeys.pieces[pieces[0]];
+    TableData counts;
+    worker.tableProbes++;
+    if (table->Probe(key, counts))
+    {
+        worker.tableHits++;
+        worker.leaves += counts.value;
+        worker.nodes += counts.extra;
+        return;
+    }
+    uint64_t leaves = worker.leaves;
+    uint64_t nodes = worker.nodes;
+    SearchSubtree(worker, grid, pieces, depth, countDistinct, table);
+    table->Store(key, TableData{worker.leaves - leaves, worker.nodes - nodes});
+}
+
+PerftResult Perft(const Grid& grid, const std::vector<int>& pieces, int depth, int numThreads, bool countDistinct,
+                  size_t tableBytes)
+{
+    PerftResult result = {0, 0, 0, 0, 0, 0, 0.0};
+    depth = std::min(depth, (int)pieces.size());
+    if (depth <= 0)
+    {
+        return result;
+    }
+    if (numThreads <= 0)
+    {
+        numThreads = std::max((int)std::thread::hardware_concurrency(), 1);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    // The first piece is placed here, each of its placements is one task
+    PerftWorker root;
+    root.levels.resize(depth);
+    root.leaves = 0;
+    root.nodes = 0;
+    root.tableProbes = 0;
+    root.tableHits = 0;
+    std::vector<Grid> tasks;
+    int numRoots = root.generator.Generate(grid, Block(pieces[0]));
+    result.nodes = numRoots;
+    for (int i = 0; i < numRoots; i++)
+    {
+        Grid next = grid;
+        next.PlaceBlock(root.generator.GetPlacement(i).block);
+        next.ClearFullRows();
+        tasks.push_back(next);
+    }
+
+    std::vector<std::unique_ptr<PerftWorker>> workers;
+    for (int i = 0; i < numThreads; i++)
+    {
+        workers.emplace_back(new PerftWorker());
+        workers.back()->levels.resize(depth);
+        workers.back()->leaves = 0;
+        workers.back()->nodes = 0;
+        workers.back()->tableProbes = 0;
+        workers.back()->tableHits = 0;
+    }
+    std::unique_ptr<TranspositionTable> table;
+    if (tableBytes > 0 && countDistinct == false)
+    {
+        table.reset(new TranspositionTable(tableBytes));
+    }
+
+    std::atomic<int> nextTask(0);
+    auto work = [&](PerftWorker& worker)
+    {
+        for (int task = nextTask++; task < (int)tasks.size(); task = nextTask++)
+        {
+            if (depth == 1)
+            {
+                worker.leaves++;
+                if (countDistinct)
+                {
+                    BoardKey key;
+                    std::copy(tasks[task].GetRowMasks(), tasks[task].GetRowMasks() + defNumRows, key.rows);
+                    worker.boards.insert(key);
+                }
+                continue;
+            }
+            CountSubtree(worker, tasks[task], pieces.data() + 1, depth - 1, countDistinct, table.get());
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < numThreads; i++)
+    {
+        threads.emplace_back(work, std::ref(*workers[i]));
+    }
+    work(*workers[0]);
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    BoardSet& boards = workers[0]->boards;
+    for (const std::unique_ptr<PerftWorker>& worker : workers)
+    {
+        result.leaves += worker->leaves;
+        result.nodes += worker->nodes;
+        result.tableProbes += worker->tableProbes;
+        result.tableHits += worker->tableHits;
+        if (worker.get() != workers[0].get())
+        {
+            boards.insert(worker->boards.begin(), worker->boards.end());
+        }
+    }
+    result.distinctBoards = countDistinct ? boards.size() : 0;
+    result.tableBytes = table ? table->GetMemoryUsage() : 0;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
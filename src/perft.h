@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "grid.h"
+
+struct PerftResult
+{
+    uint64_t leaves;         // ways to place every piece, the perft count
+    uint64_t nodes;          // boards made at every depth, leaves included
+    uint64_t distinctBoards; // different final boards by occupied cells, 0 unless counted
+    uint64_t tableProbes;    // subtrees looked up in the transposition table
+    uint64_t tableHits;      // subtrees whose counts came from the table
+    size_t tableBytes;
+    double seconds;
+};
+
+// Counts every way to place pieces[0], then pieces[1] and so on up to depth
+// pieces on the board, clearing full rows after each one. Placements come from
+// MoveGenerator, so only reachable positions count and positions covering the
+// same cells count once. The subtrees under the first piece are shared out
+// between numThreads threads, 0 uses every core.
+//
+// With tableBytes set, the counts of every subtree go into a transposition table
+// shared by the threads. A board reached again with the same pieces left, by
+// placing the same blocks in another order, takes its counts from the table
+// instead of being searched again. The counts are the same either way. Counting
+// distinct boards has to visit every leaf, so it does not use the table.
+PerftResult Perft(const Grid& grid, const std::vector<int>& pieces, int depth, int numThreads, bool countDistinct,
+                  size_t tableBytes = 0);
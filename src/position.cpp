@@ -1,7 +0,0 @@
-#include "position.h"
-
-Position::Position(int row, int column)
-{
-    this->row = row;
-    this->column = column;
-}
\ No newline at end of file
@@ -3,8 +3,9 @@
 class Position
 {
     public:
-        Position(int row, int column);
+        constexpr Position() : row(0), column(0) {}
+        constexpr Position(int row, int column) : row(row), column(column) {}
         int row;
         int column;
 
-};
\ No newline at end of file
+};
@@ -0,0 +1,247 @@
+#include <fstream>
+
+#include "replay.h"
+
+// File layout: magic, version, seed, gravity, tick count, run count, then each run
+// as its input byte followed by the run length as a LEB128 varint
+static const char replayMagic[4] = {'T', 'R', 'P', 'L'};
+static const uint32_t replayVersion = 4; // 4: SRS kicks, 3: fixed gravity, 2: seeds drive PieceBag instead of rand()
+static const uint32_t oldestReplayVersion = 4; // older files rotate with the old wall push and would play differently
+
+uint8_t PackInput(const EngineInput& input)
+{
+    uint8_t packed = 0;
+    if (input.left) packed |= InputLeft;
+    if (input.right) packed |= InputRight;
+    if (input.rotate) packed |= InputRotate;
+    if (input.softDrop) packed |= InputSoftDrop;
+    if (input.hardDrop) packed |= InputHardDrop;
+    return packed;
+}
+
+EngineInput UnpackInput(uint8_t packed)
+{
+    EngineInput input;
+    input.left = (packed & InputLeft) != 0;
+    input.right = (packed & InputRight) != 0;
+    input.rotate = (packed & InputRotate) != 0;
+    input.softDrop = (packed & InputSoftDrop) != 0;
+    input.hardDrop = (packed & InputHardDrop) != 0;
+    return input;
+}
+
+template <typename T>
+static void WriteValue(std::ofstream& file, T value)
+{
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+static bool ReadValue(std::ifstream& file, T& value)
+{
+    return (bool)file.read(reinterpret_cast<char*>(&value), sizeof(value));
+}
+
+static void WriteVarint(std::ofstream& file, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        file.put((char)((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    file.put((char)value);
+}
+
+static bool ReadVarint(std::ifstream& file, uint32_t& value)
+{
+    value = 0;
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        int byte = file.get();
+        if (byte == EOF)
+        {
+            return false;
+        }
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+Replay::Replay()
+{
+    Reset(0);
+}
+
+void Replay::Reset(uint64_t seed, int gravity)
+{
+    this->seed = seed;
+    this->gravity = gravity;
+    tickCount = 0;
+    runs.clear();
+}
+
+void Replay::Reserve(size_t numRuns)
+{
+    runs.reserve(numRuns);
+}
+
+void Replay::Record(const EngineInput& input)
+{
+    uint8_t packed = PackInput(input);
+    if (!runs.empty() && runs.back().input == packed && runs.back().length < UINT32_MAX)
+    {
+        runs.back().length++;
+    }
+    else
+    {
+        runs.push_back(ReplayRun{packed, 1});
+    }
+    tickCount++;
+}
+
+void Replay::Truncate(int64_t ticks)
+{
+    // Keeps the first ticks inputs, used when play resumes from a rewound state
+    if (ticks >= tickCount)
+    {
+        return;
+    }
+    while (!runs.empty() && tickCount - runs.back().length >= ticks)
+    {
+        tickCount -= runs.back().length;
+        runs.pop_back();
+    }
+    if (!runs.empty() && tickCount > ticks)
+    {
+        runs.back().length -= (uint32_t)(tickCount - ticks);
+        tickCount = ticks;
+    }
+}
+
+bool Replay::Save(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    file.write(replayMagic, sizeof(replayMagic));
+    WriteValue(file, replayVersion);
+    WriteValue(file, seed);
+    WriteValue(file, (int32_t)gravity);
+    WriteValue(file, tickCount);
+    WriteValue(file, (uint32_t)runs.size());
+    for (const ReplayRun& run : runs)
+    {
+        file.put((char)run.input);
+        WriteVarint(file, run.length);
+    }
+    return (bool)file;
+}
+
+bool Replay::Load(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    char magic[4];
+    uint32_t version = 0;
+    uint32_t numRuns = 0;
+    uint64_t loadedSeed = 0;
+    int32_t loadedGravity = 0;
+    int64_t loadedTickCount = 0;
+    if (!file.read(magic, sizeof(magic)) || std::string(magic, 4) != std::string(replayMagic, 4) ||
+        !ReadValue(file, version) || version < oldestReplayVersion || version > replayVersion ||
+        !ReadValue(file, loadedSeed) || !ReadValue(file, loadedGravity) ||
+        !ReadValue(file, loadedTickCount) || !ReadValue(file, numRuns))
+    {
+        return false;
+    }
+
+    Reset(loadedSeed, loadedGravity);
+    runs.reserve(numRuns);
+    for (uint32_t i = 0; i < numRuns; i++)
+    {
+        int input = file.get();
+        uint32_t length = 0;
+        if (input == EOF || !ReadVarint(file, length))
+        {
+            Reset(0);
+            return false;
+        }
+        runs.push_back(ReplayRun{(uint8_t)input, length});
+        tickCount += length;
+    }
+
+    if (tickCount != loadedTickCount)
+    {
+        Reset(0);
+        return false;
+    }
+    return true;
+}
+
+uint64_t Replay::GetSeed() const
+{
+    return seed;
+}
+
+int Replay::GetGravity() const
+{
+    return gravity;
+}
+
+int64_t Replay::GetTickCount() const
+{
+    return tickCount;
+}
+
+const std::vector<ReplayRun>& Replay::GetRuns() const
+{
+    return runs;
+}
+
+ReplayPlayer::ReplayPlayer()
+{
+    replay = nullptr;
+    runIndex = 0;
+    runPosition = 0;
+}
+
+void ReplayPlayer::Start(const Replay& replay)
+{
+    this->replay = &replay;
+    runIndex = 0;
+    runPosition = 0;
+}
+
+bool ReplayPlayer::IsFinished() const
+{
+    return replay == nullptr || runIndex >= replay->GetRuns().size();
+}
+
+EngineInput ReplayPlayer::Next()
+{
+    if (IsFinished())
+    {
+        return UnpackInput(0);
+    }
+
+    const ReplayRun& run = replay->GetRuns()[runIndex];
+    EngineInput input = UnpackInput(run.input);
+    runPosition++;
+    if (runPosition >= run.length)
+    {
+        runIndex++;
+        runPosition = 0;
+    }
+    return input;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "engine.h"
+
+// Bits of a packed EngineInput
+enum ReplayInputBit
+{
+    InputLeft = 1 << 0,
+    InputRight = 1 << 1,
+    InputRotate = 1 << 2,
+    InputSoftDrop = 1 << 3,
+    InputHardDrop = 1 << 4,
+};
+
+uint8_t PackInput(const EngineInput& input);
+EngineInput UnpackInput(uint8_t packed);
+
+// A run of consecutive ticks with the same input
+struct ReplayRun
+{
+    uint8_t input;
+    uint32_t length;
+};
+
+// A recorded game: the seed and gravity plus the run-length encoded input of every tick
+class Replay
+{
+public:
+    Replay();
+    void Reset(uint64_t seed, int gravity = 0);
+    void Reserve(size_t numRuns);
+    void Record(const EngineInput& input);
+    void Truncate(int64_t ticks);
+    bool Save(const std::string& path) const;
+    bool Load(const std::string& path);
+
+    uint64_t GetSeed() const;
+    int GetGravity() const;
+    int64_t GetTickCount() const;
+    const std::vector<ReplayRun>& GetRuns() const;
+
+private:
+    uint64_t seed;
+    int gravity;
+    int64_t tickCount;
+    std::vector<ReplayRun> runs;
+};
+
+// Reads the inputs of a replay back one tick at a time
+class ReplayPlayer
+{
+public:
+    ReplayPlayer();
+    void Start(const Replay& replay);
+    bool IsFinished() const;
+    EngineInput Next();
+
+private:
+    const Replay* replay;
+    size_t runIndex;
+    uint32_t runPosition;
+};
@@ -0,0 +1,106 @@
+#include "rewind.h"
+#include "replay.h"
+
+RewindBuffer::RewindBuffer(int capacityTicks, int keyframeInterval)
+{
+    this->keyframeInterval = keyframeInterval > 0 ? keyframeInterval : 1;
+    int numKeyframes = (capacityTicks + this->keyframeInterval - 1) / this->keyframeInterval;
+    if (numKeyframes < 1)
+    {
+        numKeyframes = 1;
+    }
+    capacity = numKeyframes * this->keyframeInterval;
+    keyframes.resize(numKeyframes);
+    inputs.resize(capacity);
+    Clear();
+}
+
+void RewindBuffer::Clear()
+{
+    oldestTick = -1;
+    newestTick = -1;
+}
+
+void RewindBuffer::Record(const Engine& engine, const EngineInput& input)
+{
+    // Called before engine.Tick(input), history starts at the first keyframe tick
+    int64_t tick = engine.GetTickCount();
+    if (tick % keyframeInterval == 0)
+    {
+        engine.SaveState(keyframes[(tick / keyframeInterval) % keyframes.size()]);
+        if (oldestTick < 0 || tick != newestTick)
+        {
+            oldestTick = tick;
+        }
+    }
+    else if (oldestTick < 0 || tick != newestTick)
+    {
+        // Not contiguous with what was recorded and no keyframe to restart from
+        Clear();
+        return;
+    }
+
+    inputs[tick % capacity] = PackInput(input);
+    newestTick = tick + 1;
+
+    // The slots just written held tick - capacity, every keyframe that needed them is gone
+    int64_t lostTick = tick - capacity;
+    if (lostTick >= oldestTick)
+    {
+        oldestTick = (lostTick / keyframeInterval + 1) * keyframeInterval;
+    }
+}
+
+int RewindBuffer::Seek(Engine& engine, int64_t tick) const
+{
+    // Returns the number of ticks simulated to reach the target, -1 when it is out of range
+    if (oldestTick < 0 || tick < oldestTick || tick > newestTick)
+    {
+        return -1;
+    }
+
+    int64_t keyframeTick = tick - tick % keyframeInterval;
+    if (keyframeTick == newestTick && keyframeTick > oldestTick)
+    {
+        keyframeTick -= keyframeInterval; // not recorded yet, the input that leads to it is
+    }
+    engine.LoadState(keyframes[(keyframeTick / keyframeInterval) % keyframes.size()]);
+    for (int64_t t = keyframeTick; t < tick; t++)
+    {
+        engine.Tick(UnpackInput(inputs[t % capacity]));
+    }
+    return (int)(tick - keyframeTick);
+}
+
+void RewindBuffer::Truncate(int64_t tick)
+{
+    // Forgets everything after tick, play resumes from there
+    if (oldestTick < 0 || tick < oldestTick)
+    {
+        Clear();
+    }
+    else if (tick < newestTick)
+    {
+        newestTick = tick;
+    }
+}
+
+int64_t RewindBuffer::GetOldestTick() const
+{
+    return oldestTick;
+}
+
+int64_t RewindBuffer::GetNewestTick() const
+{
+    return newestTick;
+}
+
+int RewindBuffer::GetKeyframeInterval() const
+{
+    return keyframeInterval;
+}
+
+size_t RewindBuffer::GetMemoryUsage() const
+{
+    return keyframes.size() * sizeof(EngineState) + inputs.size() * sizeof(uint8_t);
+}
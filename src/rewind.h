@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "engine.h"
+
+// Bounded history of the last few seconds of a game. A keyframe (a full
+// EngineState) is kept every keyframeInterval ticks and every tick in between
+// is stored as its packed input, so seeking restores the keyframe at or before
+// the target and replays at most keyframeInterval ticks. All memory is
+// allocated up front, recording never touches the heap.
+class RewindBuffer
+{
+public:
+    RewindBuffer(int capacityTicks = 60 * ticksPerSecond, int keyframeInterval = ticksPerSecond);
+    void Clear();
+    void Record(const Engine& engine, const EngineInput& input);
+    int Seek(Engine& engine, int64_t tick) const;
+    void Truncate(int64_t tick);
+
+    int64_t GetOldestTick() const;
+    int64_t GetNewestTick() const;
+    int GetKeyframeInterval() const;
+    size_t GetMemoryUsage() const;
+
+private:
+    int capacity;          // ticks of input kept, a multiple of keyframeInterval
+    int keyframeInterval;
+    std::vector<EngineState> keyframes;
+    std::vector<uint8_t> inputs;
+    int64_t oldestTick;    // oldest tick that can still be sought to, -1 while empty
+    int64_t newestTick;    // tick count after the last recorded input
+};
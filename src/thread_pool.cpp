@@ -0,0 +1,149 @@
+#include <algorithm>
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(int numThreads)
+{
+    if (numThreads <= 0)
+    {
+        numThreads = std::max((int)std::thread::hardware_concurrency(), 1);
+    }
+    body = nullptr;
+    generation = 0;
+    running = 0;
+    stopping = false;
+    for (int i = 0; i < numThreads; i++)
+    {
+        workers.emplace_back(new Worker);
+        workers.back()->next = 0;
+        workers.back()->end = 0;
+    }
+    for (int i = 1; i < numThreads; i++)
+    {
+        threads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+int ThreadPool::GetNumThreads() const
+{
+    return (int)workers.size();
+}
+
+void ThreadPool::Run(int numTasks, const std::function<void(int task, int worker)>& body)
+{
+    if (numTasks <= 0)
+    {
+        return;
+    }
+
+    // Even shares to start with, stealing evens out whatever the tasks cost
+    int numWorkers = (int)workers.size();
+    for (int i = 0; i < numWorkers; i++)
+    {
+        std::lock_guard<std::mutex> lock(workers[i]->mutex);
+        workers[i]->next = (int)((int64_t)numTasks * i / numWorkers);
+        workers[i]->end = (int)((int64_t)numTasks * (i + 1) / numWorkers);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->body = &body;
+        running = numWorkers - 1;
+        generation++;
+    }
+    wake.notify_all();
+
+    RunTasks(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this]() { return running == 0; });
+    this->body = nullptr;
+}
+
+void ThreadPool::WorkerLoop(int worker)
+{
+    int seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]() { return stopping || generation != seen; });
+            if (stopping)
+            {
+                return;
+            }
+            seen = generation;
+        }
+        RunTasks(worker);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running--;
+        }
+        done.notify_one();
+    }
+}
+
+void ThreadPool::RunTasks(int worker)
+{
+    int task = 0;
+    while (TakeTask(worker, task) || StealTask(worker, task))
+    {
+        (*body)(task, worker);
+    }
+}
+
+bool ThreadPool::TakeTask(int worker, int& task)
+{
+    Worker& own = *workers[worker];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (own.next == own.end)
+    {
+        return false;
+    }
+    task = own.next++;
+    return true;
+}
+
+bool ThreadPool::StealTask(int worker, int& task)
+{
+    // Ranges only ever shrink, so once a pass finds every range empty all tasks
+    // of this Run have been handed out
+    int numWorkers = (int)workers.size();
+    for (int i = 1; i < numWorkers; i++)
+    {
+        Worker& victim = *workers[(worker + i) % numWorkers];
+        int first = 0;
+        int last = 0;
+        {
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            int left = victim.end - victim.next;
+            if (left == 0)
+            {
+                continue;
+            }
+            first = victim.end - (left + 1) / 2;
+            last = victim.end;
+            victim.end = first;
+        }
+
+        // The first stolen task runs now, the rest become this worker's range
+        Worker& own = *workers[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        own.next = first + 1;
+        own.end = last;
+        task = first;
+        return true;
+    }
+    return false;
+}
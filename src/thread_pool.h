@@ -0,0 +1,51 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads kept alive between loops, for running many small tasks on every core.
+// Run shares the task indices out as one range per worker. A worker takes tasks
+// from the front of its own range and, once that is empty, steals the back half
+// of another worker's range, so the threads that finish early take over the work
+// of one that is held up. The calling thread works as worker 0, and Run returns
+// once every task has finished. Run is not reentrant.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(int numThreads = 0); // 0 means one per hardware thread
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int GetNumThreads() const;
+    void Run(int numTasks, const std::function<void(int task, int worker)>& body);
+
+private:
+    // The tasks from next up to end still to run, the owner and thieves both lock it
+    struct Worker
+    {
+        std::mutex mutex;
+        int next;
+        int end;
+    };
+
+    void WorkerLoop(int worker);
+    void RunTasks(int worker);
+    bool TakeTask(int worker, int& task);
+    bool StealTask(int worker, int& task);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    const std::function<void(int task, int worker)>* body;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    int generation; // counts the calls to Run, a new value wakes the threads
+    int running;    // threads still working on the current Run
+    bool stopping;
+};
@@ -0,0 +1,78 @@
+#include "transposition.h"
+
+TranspositionTable::TranspositionTable(size_t bytes)
+{
+    numSlots = 0;
+    Resize(bytes);
+}
+
+void TranspositionTable::Resize(size_t bytes)
+{
+    // The largest power of two number of slots that fits in bytes
+    size_t count = 0;
+    if (bytes >= sizeof(Slot))
+    {
+        count = 1;
+        while (count * 2 * sizeof(Slot) <= bytes)
+        {
+            count *= 2;
+        }
+    }
+    if (count != numSlots)
+    {
+        slots.reset(count > 0 ? new Slot[count] : nullptr);
+        numSlots = count;
+    }
+    Clear();
+}
+
+void TranspositionTable::Clear()
+{
+    // An empty slot matches only key 0, which a 64-bit hash is never expected to be
+    for (size_t i = 0; i < numSlots; i++)
+    {
+        slots[i].check.store(0, std::memory_order_relaxed);
+        slots[i].value.store(0, std::memory_order_relaxed);
+        slots[i].extra.store(0, std::memory_order_relaxed);
+    }
+}
+
+bool TranspositionTable::Probe(uint64_t key, TableData& data) const
+{
+    if (numSlots == 0)
+    {
+        return false;
+    }
+    const Slot& slot = slots[key & (numSlots - 1)];
+    uint64_t check = slot.check.load(std::memory_order_relaxed);
+    uint64_t value = slot.value.load(std::memory_order_relaxed);
+    uint64_t extra = slot.extra.load(std::memory_order_relaxed);
+    if ((check ^ value ^ extra) != key)
+    {
+        return false;
+    }
+    data = TableData{value, extra};
+    return true;
+}
+
+void TranspositionTable::Store(uint64_t key, const TableData& data)
+{
+    if (numSlots == 0)
+    {
+        return;
+    }
+    Slot& slot = slots[key & (numSlots - 1)];
+    slot.check.store(key ^ data.value ^ data.extra, std::memory_order_relaxed);
+    slot.value.store(data.value, std::memory_order_relaxed);
+    slot.extra.store(data.extra, std::memory_order_relaxed);
+}
+
+size_t TranspositionTable::GetNumSlots() const
+{
+    return numSlots;
+}
+
+size_t TranspositionTable::GetMemoryUsage() const
+{
+    return numSlots * sizeof(Slot);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// What a search keeps for a position, the meaning of the two words is up to it
+struct TableData
+{
+    uint64_t value;
+    uint64_t extra;
+};
+
+// Fixed-size hash table of search results keyed by Zobrist hash, shared by any
+// number of threads without locks. A slot keeps its key xor-ed with both data
+// words, and a probe only accepts a slot whose words xor back to the key, so a
+// slot read while another thread was writing it is a miss, never wrong data.
+// A store always replaces what the slot held. Hits and misses are counted by
+// the callers, a shared counter would bounce between the cores on every probe.
+class TranspositionTable
+{
+public:
+    explicit TranspositionTable(size_t bytes = 0);
+    void Resize(size_t bytes);
+    void Clear();
+    bool Probe(uint64_t key, TableData& data) const;
+    void Store(uint64_t key, const TableData& data);
+    size_t GetNumSlots() const;
+    size_t GetMemoryUsage() const;
+
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> check; // key ^ value ^ extra
+        std::atomic<uint64_t> value;
+        std::atomic<uint64_t> extra;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t numSlots; // a power of two, or 0 when the table is off
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include "blocks.h"
+
+// Random keys for Zobrist hashing: a position's hash is the xor of the keys of
+// everything in it, so setting or emptying a cell is one xor and two positions
+// reached in a different order hash the same. The keys are made at compile time
+// from fixed seeds, hashes are the same in every build and every run. The cell
+// keys are further down, sized by the board.
+const int maxZobristDepth = 64;
+
+struct ZobristKeys
+{
+    uint64_t pieces[numBlockTypes + 1];   // falling block id
+    uint64_t bagPositions[numBlockTypes]; // pieces already drawn from the current bag
+    uint64_t depths[maxZobristDepth];     // pieces left to place in a search
+};
+
+constexpr uint64_t NextZobristKey(uint64_t& state)
+{
+    // splitmix64
+    state += 0x9E3779B97F4A7C15ull;
+    uint64_t z = state;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+constexpr ZobristKeys MakeZobristKeys()
+{
+    ZobristKeys keys = {};
+    uint64_t state = 0x5A0B2157ull;
+    for (int id = 0; id <= numBlockTypes; id++)
+    {
+        keys.pieces[id] = NextZobristKey(state);
+    }
+    for (int position = 0; position < numBlockTypes; position++)
+    {
+        keys.bagPositions[position] = NextZobristKey(state);
+    }
+    for (int depth = 0; depth < maxZobristDepth; depth++)
+    {
+        keys.depths[depth] = NextZobristKey(state);
+    }
+    return keys;
+}
+
+inline constexpr ZobristKeys zobristKeys = MakeZobristKeys();
+
+// Keys for the filled cells of a board, one table per board size so any size
+// BasicGrid allows has a key for every cell
+template <int Rows, int Cols>
+struct ZobristCellKeys
+{
+    uint64_t cells[Rows][Cols];
+};
+
+template <int Rows, int Cols>
+constexpr ZobristCellKeys<Rows, Cols> MakeZobristCellKeys()
+{
+    ZobristCellKeys<Rows, Cols> keys = {};
+    uint64_t state = 0xCE11ull ^ ((uint64_t)Rows << 32) ^ (uint64_t)Cols;
+    for (int row = 0; row < Rows; row++)
+    {
+        for (int column = 0; column < Cols; column++)
+        {
+            keys.cells[row][column] = NextZobristKey(state);
+        }
+    }
+    return keys;
+}
+
+template <int Rows, int Cols>
+inline constexpr ZobristCellKeys<Rows, Cols> zobristCellKeys = MakeZobristCellKeys<Rows, Cols>();
+
+// Hash of the cells set in mask on one row of a Rows x Cols board
+template <int Rows, int Cols, typename RowMask>
+uint64_t ZobristRowHash(int row, RowMask mask)
+{
+    uint64_t hash = 0;
+    for (int column = 0; mask != 0; column++, mask >>= 1)
+    {
+        if (mask & 1)
+        {
+            hash ^= zobristCellKeys<Rows, Cols>.cells[row][column];
+        }
+    }
+    return hash;
+}
@@ -0,0 +1,968 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "engine.h"
+#include "alloc_stats.h"
+#include "rewind.h"
+#include "bot.h"
+#include "movegen.h"
+#include "perft.h"
+#include "board_features.h"
+#include "feature_tracker.h"
+
+// Microbenchmarks for the engine hot paths, printed as CSV or JSON so runs
+// can be compared across commits. The allocation columns need TETRIS_ALLOC_STATS.
+
+struct BenchResult
+{
+    std::string name;
+    long iterations;
+    double nsPerOp;
+    double allocsPerOp;
+    double bytesPerOp;
+    double opsPerSecond;
+};
+
+// Keeps results alive so the compiler cannot drop the measured work
+static volatile long benchSink = 0;
+
+// Per-op figures of ops done in seconds, with the allocation counters read before and after
+static BenchResult MakeResult(const std::string& name, long ops, double seconds, const AllocCounters& before,
+                              const AllocCounters& after)
+{
+    BenchResult result;
+    result.name = name;
+    result.iterations = ops;
+    result.nsPerOp = ops > 0 ? seconds * 1e9 / ops : 0.0;
+    result.allocsPerOp = ops > 0 ? (double)(after.count - before.count) / ops : 0.0;
+    result.bytesPerOp = ops > 0 ? (double)(after.bytes - before.bytes) / ops : 0.0;
+    result.opsPerSecond = seconds > 0.0 ? ops / seconds : 0.0;
+    return result;
+}
+
+template <typename Body>
+static BenchResult RunBench(const std::string& name, long iterations, Body body)
+{
+    long sink = 0;
+    AllocCounters before = GetAllocCounters();
+    auto start = std::chrono::steady_clock::now();
+    for (long i = 0; i < iterations; i++)
+    {
+        sink += body(i);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    AllocCounters after = GetAllocCounters();
+    benchSink = benchSink + sink;
+    return MakeResult(name, iterations, seconds, before, after);
+}
+
+static EngineInput RandomInput(std::mt19937& rng)
+{
+    EngineInput input = {false, false, false, false, false};
+    int r = rng() % 16;
+    input.left = r == 0 || r == 1;
+    input.right = r == 2 || r == 3;
+    input.rotate = r == 4;
+    input.hardDrop = r == 5;
+    return input;
+}
+
+// Mid-game positions: each seed plays random inputs until a number of pieces have locked
+static std::vector<Engine> MakeBoards(int count)
+{
+    std::vector<Engine> boards;
+    boards.reserve(count);
+    std::mt19937 rng(1234);
+    for (int i = 0; i < count; i++)
+    {
+        Engine engine;
+        engine.Reset(i + 1);
+        int targetPieces = 5 + i % 20;
+        int pieces = 0;
+        while (pieces < targetPieces && !engine.IsGameOver())
+        {
+            EngineEvents events = engine.Tick(RandomInput(rng));
+            if (events.flags & (EventLock | EventLineClear))
+            {
+                pieces++;
+            }
+        }
+        if (!engine.IsGameOver())
+        {
+            boards.push_back(engine);
+        }
+    }
+    return boards;
+}
+
+// Grids with one to four full rows mixed into a random stack
+static std::vector<Grid> MakeClearGrids(int count)
+{
+    std::vector<Grid> grids;
+    grids.reserve(count);
+    std::mt19937 rng(4321);
+    for (int i = 0; i < count; i++)
+    {
+        Grid grid;
+        int stackHeight = 6 + i % 10;
+        for (int row = defNumRows - stackHeight; row < defNumRows; row++)
+        {
+            for (int column = 0; column < defNumCols; column++)
+            {
+                if (rng() % 4 != 0)
+                {
+                    grid.SetCell(row, column, 1 + rng() % numBlockTypes);
+                }
+            }
+        }
+        int fullRows = 1 + i % 4;
+        for (int n = 0; n < fullRows; n++)
+        {
+            int row = defNumRows - 1 - (int)(rng() % stackHeight);
+            for (int column = 0; column < defNumCols; column++)
+            {
+                grid.SetCell(row, column, 1 + rng() % numBlockTypes);
+            }
+        }
+        grids.push_back(grid);
+    }
+    return grids;
+}
+
+// Drops one piece straight down in a column picked from i, clearing the board
+// once it tops out. Works on any grid type so board sizes can be compared.
+template <typename GridType>
+static long DropPiece(GridType& grid, const std::vector<Block>& pieces, long i)
+{
+    Block block = pieces[i % pieces.size()];
+    block.Move(0, (int)((i * 7) % (grid.GetNumCols() - 3)));
+    if (grid.BlockFits(block) == false)
+    {
+        grid.Initialize();
+    }
+    block.Move(grid.DropDistance(block), 0);
+    grid.PlaceBlock(block);
+    return (long)grid.ClearFullRows();
+}
+
+// Fills rows of a grid until three are full, one at each row mask width, and
+// checks both grids clear exactly those three
+template <typename GridType>
+static int VerifyFullRows(GridType& grid, DynamicGrid& dynamicGrid)
+{
+    int rows = grid.GetNumRows();
+    int columns = grid.GetNumCols();
+    for (int row = rows - 4; row < rows; row++)
+    {
+        for (int column = 0; column < columns; column++)
+        {
+            // The row second from the bottom keeps a hole in its last column
+            int value = row == rows - 2 && column == columns - 1 ? 0 : 1 + column % numBlockTypes;
+            grid.SetCell(row, column, value);
+            dynamicGrid.SetCell(row, column, value);
+        }
+    }
+    int cleared = grid.ClearFullRows();
+    int dynamicCleared = dynamicGrid.ClearFullRows();
+    bool ok = cleared == 3 && dynamicCleared == 3 && grid.IsCellEmpty(rows - 1, columns - 1) &&
+              grid.IsCellEmpty(rows - 1, 0) == false;
+    if (ok == false)
+    {
+        printf("rows: %dx%d grid cleared %d rows and the dynamic one %d, expected 3\n", columns, rows, cleared, dynamicCleared);
+    }
+    return ok ? 0 : 1;
+}
+
+static int VerifyGridSizes()
+{
+    BasicGrid<20, 16> grid16;
+    BasicGrid<20, 17> grid17;
+    BasicGrid<20, 32> grid32;
+    BasicGrid<20, 33> grid33;
+    BasicGrid<20, 64> grid64;
+    DynamicGrid dynamic16(20, 16);
+    DynamicGrid dynamic17(20, 17);
+    DynamicGrid dynamic32(20, 32);
+    DynamicGrid dynamic33(20, 33);
+    DynamicGrid dynamic64(20, 64);
+    int mismatches = VerifyFullRows(grid16, dynamic16) + VerifyFullRows(grid17, dynamic17) + VerifyFullRows(grid32, dynamic32) +
+                     VerifyFullRows(grid33, dynamic33) + VerifyFullRows(grid64, dynamic64);
+    printf("rows     line clears checked at 16, 17, 32, 33 and 64 columns\n");
+    return mismatches;
+}
+
+// Cell by cell count of every feature, the reference the batch kernels are checked against
+static BoardFeatures CountFeatures(const Grid& grid)
+{
+    BoardFeatures features = {0, 0, 0, 0, 0, 0, 0};
+    int heights[defNumCols];
+    for (int column = 0; column < defNumCols; column++)
+    {
+        heights[column] = 0;
+        bool covered = false;
+        bool previous = false;
+        for (int row = 0; row < defNumRows; row++)
+        {
+            bool filled = grid.IsCellEmpty(row, column) == false;
+            if (filled && covered == false)
+            {
+                heights[column] = defNumRows - row;
+            }
+            features.holes += covered && filled == false;
+            features.columnTransitions += filled != previous;
+            covered = covered || filled;
+            previous = filled;
+        }
+        features.columnTransitions += previous == false;
+        features.aggregateHeight += heights[column];
+        features.maxHeight = std::max(features.maxHeight, heights[column]);
+        if (column > 0)
+        {
+            features.bumpiness += std::abs(heights[column] - heights[column - 1]);
+        }
+    }
+    for (int row = 0; row < defNumRows; row++)
+    {
+        bool previous = true;
+        for (int column = 0; column <= defNumCols; column++)
+        {
+            bool filled = column == defNumCols || grid.IsCellEmpty(row, column) == false;
+            features.rowTransitions += filled != previous;
+            previous = filled;
+
+            bool open = column < defNumCols && filled == false && row < defNumRows - heights[column];
+            bool leftFilled = column == 0 || grid.IsCellEmpty(row, column - 1) == false;
+            bool rightFilled = column + 1 >= defNumCols || grid.IsCellEmpty(row, column + 1) == false;
+            features.wells += open && leftFilled && rightFilled;
+        }
+    }
+    return features;
+}
+
+static bool SameFeatures(const BoardFeatures& a, const BoardFeatures& b)
+{
+    return a.aggregateHeight == b.aggregateHeight && a.maxHeight == b.maxHeight && a.holes == b.holes &&
+           a.bumpiness == b.bumpiness && a.rowTransitions == b.rowTransitions &&
+           a.columnTransitions == b.columnTransitions && a.wells == b.wells;
+}
+
+// Runs every supported kernel over the grids in batches of varying size and
+// compares each board with the cell by cell count, returns the mismatches
+static int VerifyFeatures(const std::vector<Grid>& grids)
+{
+    int mismatches = 0;
+    BoardBatch batch;
+    BatchFeatures features;
+    for (int kernel = 0; kernel < numFeatureKernels; kernel++)
+    {
+        if (IsFeatureKernelSupported((FeatureKernel)kernel) == false)
+        {
+            printf("%-8s skipped, not supported by this CPU\n", GetFeatureKernelName((FeatureKernel)kernel));
+            continue;
+        }
+        size_t next = 0;
+        for (int size = 1; next < grids.size(); size = size % boardBatchSize + 1)
+        {
+            batch.Clear();
+            size_t first = next;
+            while (batch.count < size && next < grids.size())
+            {
+                batch.Add(grids[next++]);
+            }
+            EvaluateBatch(batch, features, (FeatureKernel)kernel);
+            for (int board = 0; board < batch.count; board++)
+            {
+                const Grid& grid = grids[first + board];
+                BoardFeatures expected = CountFeatures(grid);
+                if (SameFeatures(features.Get(board), expected) == false ||
+                    SameFeatures(GetBoardFeatures(grid), expected) == false)
+                {
+                    if (mismatches < 10)
+                    {
+                        printf("%s: board %zu differs from the cell count\n", GetFeatureKernelName((FeatureKernel)kernel), first + board);
+                        grid.Print();
+                    }
+                    mismatches++;
+                }
+            }
+        }
+        printf("%-8s %zu boards checked\n", GetFeatureKernelName((FeatureKernel)kernel), grids.size());
+    }
+    return mismatches;
+}
+
+// Zobrist hash of the grid computed from its cells, for checking the one Grid
+// keeps up to date as cells change
+static uint64_t CellHash(const Grid& grid)
+{
+    uint64_t hash = 0;
+    for (int row = 0; row < defNumRows; row++)
+    {
+        for (int column = 0; column < defNumCols; column++)
+        {
+            hash ^= grid.IsCellEmpty(row, column) ? 0 : zobristCellKeys<defNumRows, defNumCols>.cells[row][column];
+        }
+    }
+    return hash;
+}
+
+// Clears and garbage rows on copies of the grids, each hash checked against the cells
+static int VerifyHashes(const std::vector<Grid>& grids)
+{
+    int mismatches = 0;
+    int checks = 0;
+    for (size_t i = 0; i < grids.size(); i++)
+    {
+        Grid grid = grids[i];
+        bool same = grid.GetHash() == CellHash(grid);
+        grid.ClearFullRows();
+        same = same && grid.GetHash() == CellHash(grid);
+        grid.AddGarbageRows(1 + i % 4, i % defNumCols);
+        same = same && grid.GetHash() == CellHash(grid);
+        checks += 3;
+        if (same == false)
+        {
+            if (mismatches < 10)
+            {
+                printf("hash: board %zu differs from the cell hash\n", i);
+                grids[i].Print();
+            }
+            mismatches++;
+        }
+    }
+    printf("hash     %d grid hashes checked\n", checks);
+    return mismatches;
+}
+
+// Random placements and undos on a FeatureTracker, each step checked against a
+// copy of the grid made the plain way and its cell by cell count and hash
+static int VerifyTracker(const std::vector<Grid>& grids)
+{
+    int mismatches = 0;
+    int steps = 0;
+    std::mt19937 rng(1357);
+    FeatureTracker tracker;
+    std::vector<Grid> expected;
+    for (const Grid& start : grids)
+    {
+        tracker.Reset(start);
+        expected.assign(1, start);
+        expected.back().ClearFullRows();
+        for (int step = 0; step < 64; step++, steps++)
+        {
+            if (rng() % 3 == 0 && expected.size() > 1)
+            {
+                tracker.Undo();
+                expected.pop_back();
+            }
+            else
+            {
+                Block block(1 + rng() % numBlockTypes);
+                for (int turn = rng() % numRotations; turn > 0; turn--)
+                {
+                    block.Rotate();
+                }
+                const BlockRotation& shape = block.GetRotation();
+                int columns = defNumCols - (shape.maxColumn - shape.minColumn);
+                block.Move(-shape.minRow - block.GetRowOffset(), (int)(rng() % columns) - shape.minColumn - block.GetColumnOffset());
+                Grid grid = expected.back();
+                if (grid.BlockFits(block) == false)
+                {
+                    continue;
+                }
+                block.Move(grid.DropDistance(block), 0);
+                grid.PlaceBlock(block);
+                int cleared = grid.ClearFullRows();
+                if (tracker.Place(block) != cleared)
+                {
+                    mismatches++;
+                }
+                expected.push_back(grid);
+            }
+
+            const Grid& grid = expected.back();
+            bool sameGrid = tracker.GetDepth() + 1 == (int)expected.size() && tracker.GetGrid().GetHash() == CellHash(grid);
+            for (int row = 0; row < defNumRows; row++)
+            {
+                for (int column = 0; column < defNumCols; column++)
+                {
+                    sameGrid = sameGrid && tracker.GetGrid().GetCell(row, column) == grid.GetCell(row, column);
+                }
+            }
+            if (sameGrid == false || SameFeatures(tracker.GetFeatures(), CountFeatures(grid)) == false)
+            {
+                if (mismatches < 10)
+                {
+                    printf("tracker: step %d differs from the cell count\n", steps);
+                    grid.Print();
+                }
+                mismatches++;
+            }
+        }
+    }
+    printf("tracker  %d placements and undos checked\n", steps);
+    return mismatches;
+}
+
+// Moves, rotations and collision tests of every block over the grids, none of
+// which may touch the heap. Only a build that counts allocations can tell.
+static int VerifyNoAllocations(const std::vector<Grid>& grids)
+{
+    if (AllocStatsEnabled() == false)
+    {
+        printf("allocs   skipped, built without TETRIS_ALLOC_STATS (TetrisBenchAllocStats counts)\n");
+        return 0;
+    }
+    long checks = 0;
+    long sink = 0;
+    AllocCounters before = GetAllocCounters();
+    for (const Grid& grid : grids)
+    {
+        for (int id = 1; id <= numBlockTypes; id++)
+        {
+            Block block(id);
+            for (int turn = 0; turn < numRotations; turn++, block.Rotate())
+            {
+                for (int column = -3; column <= 1; column += 2)
+                {
+                    Block moved = block;
+                    moved.Move(turn * 4, column);
+                    BlockCells cells = moved.GetCellPositions();
+                    sink += cells[3].row + cells[0].column;
+                    sink += grid.BlockFits(moved) + grid.IsBlockOutside(moved);
+                    checks++;
+                }
+            }
+        }
+    }
+    AllocCounters after = GetAllocCounters();
+    benchSink = benchSink + sink;
+    uint64_t allocations = after.count - before.count;
+    printf("allocs   %ld moves, rotations and collision tests made %llu allocations\n", checks, (unsigned long long)allocations);
+    return allocations == 0 ? 0 : 1;
+}
+
+// Rollout searches on one thread and on several, without a time budget they
+// play the same rollouts and must choose the same placements with the same scores
+static int VerifyRollouts(const std::vector<Grid>& grids)
+{
+    int mismatches = 0;
+    int searches = 0;
+    Bot single;
+    Bot pooled;
+    single.SetRollouts(6, 8, 0.0, 1);
+    pooled.SetRollouts(6, 8, 0.0, 3);
+    for (size_t i = 0; i < grids.size(); i += 16, searches++)
+    {
+        Block block(1 + i % numBlockTypes);
+        int nextId = 1 + (i / numBlockTypes) % numBlockTypes;
+        BotPlacement a = single.FindPlacementByRollouts(grids[i], block, nextId);
+        BotPlacement b = pooled.FindPlacementByRollouts(grids[i], block, nextId);
+        if (a.found != b.found || a.rotation != b.rotation || a.column != b.column || a.score != b.score)
+        {
+            if (mismatches < 10)
+            {
+                printf("rollouts: board %zu chose differently on %d threads\n", i, pooled.GetRolloutThreads());
+                grids[i].Print();
+            }
+            mismatches++;
+        }
+    }
+    printf("rollouts %d searches checked on 1 and %d threads\n", searches, pooled.GetRolloutThreads());
+    return mismatches;
+}
+
+// Beam and rollout searches with a feature table choose what they choose without
+// one. Every board is searched twice, so the second search reads from the table.
+static int VerifyFeatureTable(const std::vector<Grid>& grids)
+{
+    int mismatches = 0;
+    int searches = 0;
+    Bot plain;
+    Bot cached;
+    plain.SetBeam(8, 3);
+    cached.SetBeam(8, 3);
+    cached.SetFeatureTable((size_t)1 << 20);
+    Bot plainRollouts;
+    Bot cachedRollouts;
+    plainRollouts.SetRollouts(4, 4, 0.0, 1);
+    cachedRollouts.SetRollouts(4, 4, 0.0, 3);
+    cachedRollouts.SetFeatureTable((size_t)1 << 20);
+    for (size_t i = 0; i < grids.size(); i += 16)
+    {
+        Block block(1 + i % numBlockTypes);
+        int preview[2] = {1 + (int)(i / numBlockTypes) % numBlockTypes, 1 + (int)(i / 3) % numBlockTypes};
+        for (int repeat = 0; repeat < 2; repeat++, searches++)
+        {
+            BotPlacement a = plain.FindPlacement(grids[i], block, preview, 2);
+            BotPlacement b = cached.FindPlacement(grids[i], block, preview, 2);
+            BotPlacement c = plainRollouts.FindPlacementByRollouts(grids[i], block, preview[0]);
+            BotPlacement d = cachedRollouts.FindPlacementByRollouts(grids[i], block, preview[0]);
+            if (a.found != b.found || a.rotation != b.rotation || a.column != b.column || a.score != b.score ||
+                c.found != d.found || c.rotation != d.rotation || c.column != d.column || c.score != d.score)
+            {
+                if (mismatches < 10)
+                {
+                    printf("feature table: board %zu chose differently with the table\n", i);
+                    grids[i].Print();
+                }
+                mismatches++;
+            }
+        }
+    }
+    const BotSearchStats& beamStats = cached.GetSearchStats();
+    const BotSearchStats& rolloutStats = cachedRollouts.GetSearchStats();
+    if (beamStats.tableHits == 0 || rolloutStats.tableHits == 0)
+    {
+        printf("feature table: no hits, the table was never read\n");
+        mismatches++;
+    }
+    printf("feature table %d beam and rollout searches checked, %.1f%% and %.1f%% hits\n", searches,
+           100.0 * beamStats.tableHits / std::max(beamStats.tableProbes, (int64_t)1),
+           100.0 * rolloutStats.tableHits / std::max(rolloutStats.tableProbes, (int64_t)1));
+    return mismatches;
+}
+
+static void PrintResults(const std::vector<BenchResult>& results, bool json)
+{
+    if (json)
+    {
+        printf("[\n");
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const BenchResult& r = results[i];
+            printf("  {\"name\": \"%s\", \"iterations\": %ld, \"ns_per_op\": %.3f, \"allocs_per_op\": %.3f, \"bytes_per_op\": %.1f, \"ops_per_sec\": %.0f}%s\n",
+                   r.name.c_str(), r.iterations, r.nsPerOp, r.allocsPerOp, r.bytesPerOp, r.opsPerSecond, i + 1 < results.size() ? "," : "");
+        }
+        printf("]\n");
+    }
+    else
+    {
+        printf("name,iterations,ns_per_op,allocs_per_op,bytes_per_op,ops_per_sec\n");
+        for (const BenchResult& r : results)
+        {
+            printf("%s,%ld,%.3f,%.3f,%.1f,%.0f\n", r.name.c_str(), r.iterations, r.nsPerOp, r.allocsPerOp, r.bytesPerOp, r.opsPerSecond);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool json = false;
+    long iterations = 2000000;
+    std::string filter;
+    bool verify = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--json") == 0)
+        {
+            json = true;
+        }
+        else if (strcmp(argv[i], "--csv") == 0)
+        {
+            json = false;
+        }
+        else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+        {
+            iterations = atol(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+        {
+            filter = argv[++i];
+        }
+        else if (strcmp(argv[i], "--verify") == 0)
+        {
+            verify = true;
+        }
+        else
+        {
+            printf("Usage: %s [--csv | --json] [--iterations N] [--filter NAME] [--verify]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    const std::vector<Engine> boards = MakeBoards(256);
+    const std::vector<Grid> clearGrids = MakeClearGrids(256);
+    const size_t numBoards = boards.size();
+
+    // Mid-game, cleared and random boards, every density from empty to nearly full
+    std::vector<Grid> featureGrids = clearGrids;
+    std::mt19937 featureRng(2468);
+    for (const Engine& board : boards)
+    {
+        featureGrids.push_back(board.GetGrid());
+    }
+    for (int i = 0; i < 4096; i++)
+    {
+        Grid grid;
+        int density = i % 9;
+        int stackHeight = i % (defNumRows + 1);
+        for (int row = defNumRows - stackHeight; row < defNumRows; row++)
+        {
+            for (int column = 0; column < defNumCols; column++)
+            {
+                if ((int)(featureRng() % 8) < density)
+                {
+                    grid.SetCell(row, column, 1 + featureRng() % numBlockTypes);
+                }
+            }
+        }
+        featureGrids.push_back(grid);
+    }
+
+    if (verify)
+    {
+        int mismatches = VerifyGridSizes() + VerifyFeatures(featureGrids) + VerifyHashes(featureGrids) + VerifyTracker(featureGrids) +
+                         VerifyRollouts(featureGrids) + VerifyFeatureTable(featureGrids) + VerifyNoAllocations(featureGrids);
+        printf("%d mismatches\n", mismatches);
+        return mismatches == 0 ? 0 : 1;
+    }
+
+    // Blocks at every rotation and a spread of columns, many of them touching the stack
+    std::vector<Block> probes;
+    for (int id = 1; id <= numBlockTypes; id++)
+    {
+        for (int rotation = 0; rotation < numRotations; rotation++)
+        {
+            for (int column = -3; column <= 4; column++)
+            {
+                for (int row = 0; row < defNumRows; row += 3)
+                {
+                    Block block(id);
+                    for (int r = 0; r < rotation; r++)
+                    {
+                        block.Rotate();
+                    }
+                    block.Move(row, column);
+                    probes.push_back(block);
+                }
+            }
+        }
+    }
+    const size_t numProbes = probes.size();
+
+    std::vector<BenchResult> results;
+    auto add = [&](const std::string& name, long count, auto body)
+    {
+        if (filter.empty() || name.find(filter) != std::string::npos)
+        {
+            results.push_back(RunBench(name, count, body));
+        }
+    };
+
+    add("Engine::BlockFits", iterations, [&](long i)
+    {
+        return (long)boards[i % numBoards].BlockFits(probes[i % numProbes]);
+    });
+    add("Engine::IsBlockOutside", iterations, [&](long i)
+    {
+        return (long)boards[i % numBoards].IsBlockOutside(probes[i % numProbes]);
+    });
+    add("Grid copy", iterations, [&](long i)
+    {
+        Grid grid = clearGrids[i % clearGrids.size()];
+        return (long)grid.GetRowMask(defNumRows - 1);
+    });
+    add("Grid::ClearFullRows (incl. grid copy)", iterations, [&](long i)
+    {
+        Grid grid = clearGrids[i % clearGrids.size()];
+        return (long)grid.ClearFullRows();
+    });
+    add("Grid::AddGarbageRows (incl. grid copy)", iterations, [&](long i)
+    {
+        Grid grid = clearGrids[i % clearGrids.size()];
+        return (long)grid.AddGarbageRows(1 + i % 4, i % defNumCols);
+    });
+    add("Engine::GetGhostPiece", iterations, [&](long i)
+    {
+        return (long)boards[i % numBoards].GetGhostPiece().GetRowOffset();
+    });
+    add("Grid::DropDistance", iterations, [&](long i)
+    {
+        const Engine& board = boards[i % numBoards];
+        return (long)board.GetGrid().DropDistance(board.GetCurrentBlock());
+    });
+    add("Engine copy", iterations / 4, [&](long i)
+    {
+        Engine engine = boards[i % numBoards];
+        return (long)engine.GetScore();
+    });
+    EngineState snapshot;
+    add("Engine::SaveState", iterations, [&](long i)
+    {
+        boards[i % numBoards].SaveState(snapshot);
+        return (long)snapshot.score;
+    });
+    Engine restored;
+    add("Engine::LoadState", iterations, [&](long i)
+    {
+        restored.LoadState(boards[i % numBoards].GetState());
+        return (long)restored.GetScore();
+    });
+
+    // One whole game in the default rewind layout, seeks land anywhere in it and
+    // cost at most one keyframe interval of ticks wherever they land
+    RewindBuffer rewind;
+    Engine rewindEngine;
+    {
+        std::mt19937 rng(7);
+        while (!rewindEngine.IsGameOver())
+        {
+            EngineInput input = RandomInput(rng);
+            rewind.Record(rewindEngine, input);
+            rewindEngine.Tick(input);
+        }
+    }
+    const int64_t rewindSpan = rewind.GetNewestTick() - rewind.GetOldestTick() + 1;
+    add("RewindBuffer::Seek", iterations / 20, [&](long i)
+    {
+        return (long)rewind.Seek(rewindEngine, rewind.GetOldestTick() + (i * 7919) % rewindSpan);
+    });
+    add("Engine::HardDropBlock (incl. engine copy)", iterations / 4, [&](long i)
+    {
+        Engine engine = boards[i % numBoards];
+        engine.HardDropBlock();
+        return (long)engine.GetScore();
+    });
+    add("Engine::RotateBlock (incl. engine copy)", iterations / 4, [&](long i)
+    {
+        Engine engine = boards[i % numBoards];
+        return (long)engine.RotateBlock();
+    });
+    MoveGenerator moveGenerator;
+    add("MoveGenerator::Generate", iterations / 50, [&](long i)
+    {
+        const Engine& board = boards[i % numBoards];
+        return (long)moveGenerator.Generate(board.GetGrid(), board.GetCurrentBlock());
+    });
+    add("Block::GetCellPositions", iterations, [&](long i)
+    {
+        BlockCells cells = probes[i % numProbes].GetCellPositions();
+        return (long)cells[3].row;
+    });
+    add("Block::Rotate", iterations, [&](long i)
+    {
+        Block block = probes[i % numProbes];
+        block.Rotate();
+        return (long)block.GetRotation().maxRow;
+    });
+
+    // Board size scaling, the compile-time sized grid against the runtime-sized one
+    std::vector<Block> dropPieces;
+    for (int id = 1; id <= numBlockTypes; id++)
+    {
+        for (int rotation = 0; rotation < numRotations; rotation++)
+        {
+            Block block(id);
+            for (int r = 0; r < rotation; r++)
+            {
+                block.Rotate();
+            }
+            block.Move(-block.GetRowOffset(), -block.GetColumnOffset());
+            dropPieces.push_back(block);
+        }
+    }
+    auto addDropBench = [&](const std::string& size, auto& fixedGrid, int rows, int columns)
+    {
+        add("drop piece " + size + " BasicGrid", iterations / 4, [&](long i)
+        {
+            return DropPiece(fixedGrid, dropPieces, i);
+        });
+        DynamicGrid dynamicGrid(rows, columns);
+        add("drop piece " + size + " DynamicGrid", iterations / 4, [&](long i)
+        {
+            return DropPiece(dynamicGrid, dropPieces, i);
+        });
+    };
+    Grid grid10x20;
+    BasicGrid<40, 20> grid20x40;
+    BasicGrid<40, 32> grid32x40;
+    BasicGrid<40, 40> grid40x40;
+    BasicGrid<64, 64> grid64x64;
+    addDropBench("10x20", grid10x20, 20, 10);
+    addDropBench("20x40", grid20x40, 40, 20);
+    addDropBench("32x40", grid32x40, 40, 32);
+    addDropBench("40x40", grid40x40, 40, 40);
+    addDropBench("64x64", grid64x64, 64, 64);
+
+    // Whole games with the random input policy, one op is one locked piece
+    auto addGameBench = [&](const std::string& name, int gravity)
+    {
+        if (filter.empty() == false && name.find(filter) == std::string::npos)
+        {
+            return;
+        }
+        std::mt19937 rng(99);
+        Engine engine;
+        long pieces = 0;
+        AllocCounters before = GetAllocCounters();
+        auto start = std::chrono::steady_clock::now();
+        for (int game = 0; pieces < iterations / 100; game++)
+        {
+            engine.Reset(game, gravity);
+            while (!engine.IsGameOver())
+            {
+                EngineEvents events = engine.Tick(RandomInput(rng));
+                if (events.flags & (EventLock | EventLineClear))
+                {
+                    pieces++;
+                }
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        results.push_back(MakeResult(name, pieces, seconds, before, GetAllocCounters()));
+    };
+    addGameBench("full game (pieces)", 0);
+    addGameBench("full game 20G (pieces)", instantGravity);
+
+    // Feature counts of 64 boards at once with each kernel the CPU supports
+    std::vector<BoardBatch> featureBatches(featureGrids.size() / boardBatchSize);
+    for (size_t i = 0; i < featureBatches.size() * boardBatchSize; i++)
+    {
+        featureBatches[i / boardBatchSize].Add(featureGrids[i]);
+    }
+    BatchFeatures batchFeatures;
+    for (int kernel = 0; kernel < numFeatureKernels; kernel++)
+    {
+        if (IsFeatureKernelSupported((FeatureKernel)kernel))
+        {
+            std::string name = std::string("EvaluateBatch ") + GetFeatureKernelName((FeatureKernel)kernel) + " (batches of 64)";
+            add(name, iterations / boardBatchSize, [&](long i)
+            {
+                EvaluateBatch(featureBatches[i % featureBatches.size()], batchFeatures, (FeatureKernel)kernel);
+                return (long)batchFeatures.holes[i % boardBatchSize];
+            });
+        }
+    }
+    add("GetBoardFeatures", iterations, [&](long i)
+    {
+        return (long)GetBoardFeatures(featureGrids[i % featureGrids.size()]).holes;
+    });
+
+    // Placing a block and recounting its features: by copying the grid and counting
+    // the whole board, and with a FeatureTracker placing and undoing it
+    std::vector<Block> landings;
+    for (size_t i = 0; i < numBoards; i++)
+    {
+        const Grid& grid = boards[i].GetGrid();
+        Block block = boards[i].GetCurrentBlock();
+        block.Move(grid.DropDistance(block), 0);
+        landings.push_back(block);
+    }
+    add("place + GetBoardFeatures (grid copy)", iterations, [&](long i)
+    {
+        Grid grid = boards[i % numBoards].GetGrid();
+        grid.PlaceBlock(landings[i % numBoards]);
+        grid.ClearFullRows();
+        return (long)GetBoardFeatures(grid).holes;
+    });
+    std::vector<FeatureTracker> trackers;
+    for (const Engine& board : boards)
+    {
+        trackers.emplace_back(board.GetGrid());
+    }
+    add("FeatureTracker::Place + Undo", iterations, [&](long i)
+    {
+        FeatureTracker& tracker = trackers[i % numBoards];
+        tracker.Place(landings[i % numBoards]);
+        long holes = tracker.GetFeatures().holes;
+        tracker.Undo();
+        return holes;
+    });
+
+    // Bot search over the mid-game boards, one op is one placement dropped and scored.
+    // Beam searches see the next block and the bag as the game would show it.
+    auto addBotBench = [&](const std::string& name, bool lookahead, int beamWidth, int beamDepth, size_t tableBytes)
+    {
+        if (filter.empty() == false && name.find(filter) == std::string::npos)
+        {
+            return;
+        }
+        Bot bot;
+        bot.SetBeam(beamWidth, beamDepth);
+        bot.SetFeatureTable(tableBytes);
+        long checksum = 0;
+        int preview[maxBeamDepth];
+        AllocCounters before = GetAllocCounters();
+        auto start = std::chrono::steady_clock::now();
+        for (long i = 0; bot.GetPlacementsEvaluated() < iterations; i++)
+        {
+            const Engine& board = boards[i % numBoards];
+            if (beamDepth > 0)
+            {
+                preview[0] = board.GetNextBlock().id;
+                for (int n = 1; n + 1 < beamDepth; n++)
+                {
+                    preview[n] = board.GetBag().Peek(n - 1);
+                }
+                checksum += bot.FindPlacement(board.GetGrid(), board.GetCurrentBlock(), preview, beamDepth - 1).column;
+                continue;
+            }
+            int nextId = lookahead ? board.GetNextBlock().id : 0;
+            checksum += bot.FindPlacement(board.GetGrid(), board.GetCurrentBlock(), nextId).column;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        results.push_back(MakeResult(name, (long)bot.GetPlacementsEvaluated(), seconds, before, GetAllocCounters()));
+        benchSink = benchSink + checksum;
+    };
+    addBotBench("Bot::FindPlacement (placements)", false, 1, 0, 0);
+    addBotBench("Bot::FindPlacement lookahead (placements)", true, 1, 0, 0);
+    addBotBench("Bot::FindPlacement beam 32x4 (placements)", false, 32, 4, 0);
+    addBotBench("Bot::FindPlacement beam 32x4 with 16 MB table (placements)", false, 32, 4, (size_t)16 << 20);
+
+    // Rollout search on every hardware thread, one op is one rollout of 8 pieces
+    auto addRolloutBench = [&](const std::string& name, size_t tableBytes)
+    {
+        if (filter.empty() == false && name.find(filter) == std::string::npos)
+        {
+            return;
+        }
+        Bot bot;
+        bot.SetRollouts(defaultRolloutDepth, 16, 0.0, 0);
+        bot.SetFeatureTable(tableBytes);
+        long checksum = 0;
+        long rollouts = std::max(iterations / 100, 1L);
+        AllocCounters before = GetAllocCounters();
+        auto start = std::chrono::steady_clock::now();
+        for (long i = 0; bot.GetSearchStats().rollouts < rollouts; i++)
+        {
+            const Engine& board = boards[i % numBoards];
+            checksum += bot.FindPlacementByRollouts(board.GetGrid(), board.GetCurrentBlock(), board.GetNextBlock().id).column;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        results.push_back(MakeResult(name, (long)bot.GetSearchStats().rollouts, seconds, before, GetAllocCounters()));
+        benchSink = benchSink + checksum;
+    };
+    addRolloutBench("Bot::FindPlacementByRollouts (rollouts)", 0);
+    addRolloutBench("Bot::FindPlacementByRollouts with 16 MB table (rollouts)", (size_t)16 << 20);
+
+    // Perft on one thread, one op is one board made by the move generator
+    auto addPerftBench = [&](const std::string& name, size_t tableBytes)
+    {
+        if (filter.empty() == false && name.find(filter) == std::string::npos)
+        {
+            return;
+        }
+        PieceBag bag(1);
+        std::vector<int> pieces;
+        for (int i = 0; i < 4; i++)
+        {
+            pieces.push_back(bag.Next());
+        }
+        AllocCounters before = GetAllocCounters();
+        PerftResult perft = Perft(Grid(), pieces, 4, 1, false, tableBytes);
+        results.push_back(MakeResult(name, (long)perft.nodes, perft.seconds, before, GetAllocCounters()));
+    };
+    addPerftBench("Perft (nodes)", 0);
+    addPerftBench("Perft with 1 MB table (nodes)", (size_t)1 << 20);
+
+    PrintResults(results, json);
+    return 0;
+}
@@ -0,0 +1,560 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "alloc_stats.h"
+#include "bot.h"
+#include "engine.h"
+#include "perft.h"
+#include "replay.h"
+
+// Runs games without a window or audio device, as fast as the CPU allows
+
+enum SimulationMode
+{
+    ModeTick,   // Engine::Tick once per tick
+    ModeSkip,   // Engine::Advance, skipping ticks where nothing happens
+    ModeVerify, // both side by side, comparing the states after every input run
+};
+
+// An input held down for a number of ticks
+struct PolicyRun
+{
+    EngineInput input;
+    int ticks;
+};
+
+struct SimulationTotals
+{
+    long ticks;
+    long pieces;
+    long lines;
+    long mismatches;
+    uint64_t peakStepAllocs; // most heap allocations made by one Tick or Advance
+};
+
+static PolicyRun RandomInputRun(std::mt19937& rng)
+{
+    PolicyRun run;
+    run.input = {false, false, false, false, false};
+    int r = rng() % 16;
+    run.input.left = r == 0 || r == 1;
+    run.input.right = r == 2 || r == 3;
+    run.input.rotate = r == 4;
+    run.input.hardDrop = r == 5;
+    bool idle = r > 5;
+    run.ticks = idle ? 1 + rng() % 30 : 1 + rng() % 4;
+    return run;
+}
+
+static void CountEvents(const EngineEvents& events, SimulationTotals& totals)
+{
+    if (events.flags & (EventLock | EventLineClear))
+    {
+        totals.pieces++;
+    }
+    totals.lines += events.clearedRows;
+}
+
+// Runs one held input, returns the ticks simulated (fewer when the game ends)
+static int64_t StepRun(Engine& engine, const EngineInput& input, int64_t ticks, bool skip, SimulationTotals& totals)
+{
+    int64_t simulated = 0;
+    while (simulated < ticks && !engine.IsGameOver())
+    {
+        AllocCounters before = GetAllocCounters();
+        if (skip)
+        {
+            int64_t advanced = 0;
+            CountEvents(engine.Advance(input, ticks - simulated, advanced), totals);
+            simulated += advanced;
+        }
+        else
+        {
+            CountEvents(engine.Tick(input), totals);
+            simulated++;
+        }
+        totals.peakStepAllocs = std::max(totals.peakStepAllocs, GetAllocCounters().count - before.count);
+    }
+    totals.ticks += simulated;
+    return simulated;
+}
+
+static bool SameBlock(const Block& a, const Block& b)
+{
+    return a.id == b.id && &a.GetRotation() == &b.GetRotation() &&
+           a.GetRowOffset() == b.GetRowOffset() && a.GetColumnOffset() == b.GetColumnOffset();
+}
+
+// Field by field, a memcmp of the snapshots would also compare padding bytes
+static bool SameState(const Engine& a, const Engine& b)
+{
+    const EngineState& x = a.GetState();
+    const EngineState& y = b.GetState();
+    for (int row = 0; row < defNumRows; row++)
+    {
+        for (int column = 0; column < defNumCols; column++)
+        {
+            if (x.grid.GetCell(row, column) != y.grid.GetCell(row, column))
+            {
+                return false;
+            }
+        }
+    }
+    for (int i = 0; i < numBlockTypes; i++)
+    {
+        if (x.bag.Peek(i) != y.bag.Peek(i))
+        {
+            return false;
+        }
+    }
+    return SameBlock(x.currentBlock, y.currentBlock) && SameBlock(x.nextBlock, y.nextBlock) &&
+           SameBlock(x.ghostBlock, y.ghostBlock) && x.bag.GetBagPosition() == y.bag.GetBagPosition() &&
+           x.score == y.score && x.currentLevel == y.currentLevel && x.gameOver == y.gameOver &&
+           x.tickCount == y.tickCount && x.gravityTicks == y.gravityTicks &&
+           x.gravity == y.gravity && x.gravityFraction == y.gravityFraction && x.inputTicks == y.inputTicks &&
+           x.rotateInputTicks == y.rotateInputTicks && x.dropAfterSpawnTicks == y.dropAfterSpawnTicks &&
+           x.lockBlock == y.lockBlock && x.firstDrop == y.firstDrop && x.lockBlockTicks == y.lockBlockTicks &&
+           x.lockStateMoves == y.lockStateMoves;
+}
+
+// Plays one input run in the chosen mode, in verify mode a second engine follows tick by tick
+static int64_t PlayRun(Engine& engine, Engine& reference, const EngineInput& input, int64_t ticks, SimulationMode mode, SimulationTotals& totals)
+{
+    int64_t simulated = StepRun(engine, input, ticks, mode != ModeTick, totals);
+    if (mode == ModeVerify)
+    {
+        SimulationTotals referenceTotals = {0, 0, 0, 0, 0};
+        if (StepRun(reference, input, ticks, false, referenceTotals) != simulated || SameState(engine, reference) == false)
+        {
+            totals.mismatches++;
+        }
+    }
+    return simulated;
+}
+
+static void PrintUsage(const char* program)
+{
+    printf("Usage: %s [--games N] [--seed S] [--gravity G] [--record FILE] [--skip | --verify]\n", program);
+    printf("       %*s [--bot [--lookahead | --beam WIDTH,DEPTH | --rollouts DEPTH,COUNT[,MS] [--threads N]] [--hash MB]\n", (int)strlen(program), "");
+    printf("       %*s        [--weights HEIGHT,LINES,HOLES,BUMPINESS[,ROWTRANS,COLTRANS,WELLS]]]\n", (int)strlen(program), "");
+    printf("       %s --replay FILE [--skip | --verify] [--alloc-budget N]\n", program);
+    printf("       %s --perft DEPTH [--seed S] [--garbage ROWS] [--threads N] [--distinct | --hash MB]\n", program);
+    printf("       %s --perft-check [--threads N] [--hash MB]\n", program);
+}
+
+// With allocBudget at 0 or more the replay fails once a single tick allocates more
+static int PlayReplay(const std::string& path, SimulationMode mode, int64_t allocBudget)
+{
+    if (allocBudget >= 0 && AllocStatsEnabled() == false)
+    {
+        printf("--alloc-budget needs a runner that counts allocations, such as TetrisHeadlessAllocStats\n");
+        return 1;
+    }
+    Replay replay;
+    if (!replay.Load(path))
+    {
+        printf("Failed to load replay %s\n", path.c_str());
+        return 1;
+    }
+
+    Engine engine;
+    Engine reference;
+    engine.Reset(replay.GetSeed(), replay.GetGravity());
+    reference.Reset(replay.GetSeed(), replay.GetGravity());
+
+    SimulationTotals totals = {0, 0, 0, 0, 0};
+    auto start = std::chrono::steady_clock::now();
+    for (const ReplayRun& run : replay.GetRuns())
+    {
+        if (engine.IsGameOver())
+        {
+            break;
+        }
+        PlayRun(engine, reference, UnpackInput(run.input), run.length, mode, totals);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double simulatedSeconds = (double)engine.GetTickCount() / ticksPerSecond;
+
+    printf("seed: %llu\n", (unsigned long long)replay.GetSeed());
+    printf("ticks: %lld of %lld\n", (long long)engine.GetTickCount(), (long long)replay.GetTickCount());
+    printf("simulated time: %.1f s\n", simulatedSeconds);
+    printf("pieces: %ld\n", totals.pieces);
+    printf("lines: %ld\n", totals.lines);
+    printf("score: %d\n", engine.GetScore());
+    printf("game over: %s\n", engine.IsGameOver() ? "yes" : "no");
+    printf("time: %.6f s\n", seconds);
+    if (seconds > 0.0)
+    {
+        printf("ticks/s: %.0f\n", engine.GetTickCount() / seconds);
+        printf("speed: %.0fx real time\n", simulatedSeconds / seconds);
+    }
+    if (AllocStatsEnabled())
+    {
+        printf("peak allocations per tick: %llu\n", (unsigned long long)totals.peakStepAllocs);
+    }
+    bool overBudget = allocBudget >= 0 && totals.peakStepAllocs > (uint64_t)allocBudget;
+    if (overBudget)
+    {
+        printf("allocation budget exceeded: %llu allocations in one tick, budget %lld\n",
+               (unsigned long long)totals.peakStepAllocs, (long long)allocBudget);
+    }
+    if (mode == ModeVerify)
+    {
+        printf("verify: %zu runs, %ld mismatches\n", replay.GetRuns().size(), totals.mismatches);
+        return totals.mismatches == 0 && overBudget == false ? 0 : 1;
+    }
+    return overBudget ? 1 : 0;
+}
+
+// Pieces in the order a game with this seed deals them
+static std::vector<int> PerftPieces(uint64_t seed, int count)
+{
+    PieceBag bag(seed);
+    std::vector<int> pieces;
+    for (int i = 0; i < count; i++)
+    {
+        pieces.push_back(bag.Next());
+    }
+    return pieces;
+}
+
+// Garbage rows with the holes in different columns, so some placements clear lines
+static Grid PerftBoard(uint64_t seed, int garbageRows)
+{
+    Grid grid;
+    for (int i = 0; i < garbageRows; i++)
+    {
+        grid.AddGarbageRows(1, (int)((seed + 3 * i) % defNumCols));
+    }
+    return grid;
+}
+
+static int RunPerft(uint64_t seed, int garbageRows, int depth, int numThreads, bool countDistinct, size_t tableBytes)
+{
+    std::vector<int> pieces = PerftPieces(seed, depth);
+    Grid grid = PerftBoard(seed, garbageRows);
+    printf("seed: %llu\n", (unsigned long long)seed);
+    printf("garbage rows: %d\n", garbageRows);
+    printf("pieces:");
+    for (int id : pieces)
+    {
+        printf(" %d", id);
+    }
+    printf("\n");
+    for (int d = 1; d <= depth; d++)
+    {
+        PerftResult result = Perft(grid, pieces, d, numThreads, countDistinct, tableBytes);
+        printf("perft %d: %llu leaves, %llu nodes", d, (unsigned long long)result.leaves, (unsigned long long)result.nodes);
+        if (countDistinct)
+        {
+            printf(", %llu distinct boards", (unsigned long long)result.distinctBoards);
+        }
+        if (result.tableBytes > 0)
+        {
+            printf(", table %.1f%% hits of %llu probes in %zu MB",
+                   result.tableProbes > 0 ? 100.0 * result.tableHits / result.tableProbes : 0.0,
+                   (unsigned long long)result.tableProbes, result.tableBytes >> 20);
+        }
+        printf(", %.3f s", result.seconds);
+        if (result.seconds > 0.0)
+        {
+            printf(", %.0f nodes/s", result.nodes / result.seconds);
+        }
+        printf("\n");
+    }
+    return 0;
+}
+
+// Leaf counts for the first pieces of a few seeds, on empty boards and on boards
+// with garbage. A change to collision, rotation, kicks or line clears shows up
+// as a different count.
+struct PerftCheck
+{
+    uint64_t seed;
+    int garbageRows;
+    int depth;
+    uint64_t leaves;
+};
+
+static const PerftCheck perftChecks[] =
+{
+    {1, 0, 4, 97723},
+    {2, 0, 4, 388309},
+    {3, 0, 4, 392106},
+    {1, 6, 4, 97594},
+    {2, 6, 4, 387294},
+    {4, 6, 4, 775579},
+};
+
+static int RunPerftCheck(int numThreads, size_t tableBytes)
+{
+    // Every check runs without and with the transposition table, both must match
+    int failures = 0;
+    for (const PerftCheck& check : perftChecks)
+    {
+        Grid grid = PerftBoard(check.seed, check.garbageRows);
+        for (size_t bytes : {(size_t)0, tableBytes})
+        {
+            PerftResult result = Perft(grid, PerftPieces(check.seed, check.depth), check.depth, numThreads, false, bytes);
+            bool ok = result.leaves == check.leaves;
+            printf("seed %llu, %d garbage rows, depth %d%s: %llu leaves, expected %llu %s\n", (unsigned long long)check.seed,
+                   check.garbageRows, check.depth, bytes > 0 ? ", table" : "", (unsigned long long)result.leaves,
+                   (unsigned long long)check.leaves, ok ? "ok" : "FAILED");
+            failures += ok ? 0 : 1;
+        }
+    }
+    printf("perft check: %d failed\n", failures);
+    return failures == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+    int numGames = 100;
+    uint64_t seed = 1;
+    int gravity = 0;
+    std::string recordPath;
+    std::string replayPath;
+    SimulationMode mode = ModeTick;
+    int perftDepth = 0;
+    int perftGarbage = 0;
+    bool perftCheck = false;
+    bool perftDistinct = false;
+    size_t tableBytes = 0;
+    int64_t allocBudget = -1;
+    int numThreads = 0;
+    bool useBot = false;
+    int rolloutDepth = 0;
+    int rolloutCount = defaultRolloutCount;
+    double rolloutBudgetMs = 0.0;
+    Bot bot;
+    const long maxTicksPerGame = 1000000;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--games") == 0 && i + 1 < argc)
+        {
+            numGames = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            seed = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--gravity") == 0 && i + 1 < argc)
+        {
+            // In rows per tick, 20 is 20G
+            gravity = (int)(atof(argv[++i]) * gravityUnit);
+        }
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+        {
+            recordPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+        {
+            replayPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--perft") == 0 && i + 1 < argc)
+        {
+            perftDepth = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--garbage") == 0 && i + 1 < argc)
+        {
+            perftGarbage = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--perft-check") == 0)
+        {
+            perftCheck = true;
+        }
+        else if (strcmp(argv[i], "--alloc-budget") == 0 && i + 1 < argc)
+        {
+            allocBudget = atoll(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--hash") == 0 && i + 1 < argc)
+        {
+            tableBytes = (size_t)atol(argv[++i]) << 20;
+        }
+        else if (strcmp(argv[i], "--distinct") == 0)
+        {
+            perftDistinct = true;
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            numThreads = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--bot") == 0)
+        {
+            useBot = true;
+        }
+        else if (strcmp(argv[i], "--lookahead") == 0)
+        {
+            bot.SetLookahead(true);
+        }
+        else if (strcmp(argv[i], "--beam") == 0 && i + 1 < argc)
+        {
+            int width = 0;
+            int depth = 0;
+            if (sscanf(argv[++i], "%d,%d", &width, &depth) != 2 || width < 1 || depth < 1 || depth > maxBeamDepth)
+            {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+            bot.SetBeam(width, depth);
+        }
+        else if (strcmp(argv[i], "--rollouts") == 0 && i + 1 < argc)
+        {
+            // The time budget is optional, without one every search plays all its rollouts
+            int fields = sscanf(argv[++i], "%d,%d,%lf", &rolloutDepth, &rolloutCount, &rolloutBudgetMs);
+            if (fields < 2 || rolloutDepth < 1 || rolloutCount < 1 || rolloutBudgetMs < 0.0)
+            {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--weights") == 0 && i + 1 < argc)
+        {
+            BotWeights weights = defaultBotWeights;
+            // The last three are optional, they default to 0 like defaultBotWeights
+            int read = sscanf(argv[++i], "%lf,%lf,%lf,%lf,%lf,%lf,%lf", &weights.aggregateHeight,
+                              &weights.completeLines, &weights.holes, &weights.bumpiness, &weights.rowTransitions,
+                              &weights.columnTransitions, &weights.wells);
+            if (read != 4 && read != 7)
+            {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+            bot.SetWeights(weights);
+        }
+        else if (strcmp(argv[i], "--skip") == 0)
+        {
+            mode = ModeSkip;
+        }
+        else if (strcmp(argv[i], "--verify") == 0)
+        {
+            mode = ModeVerify;
+        }
+        else
+        {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (rolloutDepth > 0)
+    {
+        bot.SetRollouts(rolloutDepth, rolloutCount, rolloutBudgetMs / 1e3, numThreads);
+    }
+    if (useBot)
+    {
+        bot.SetFeatureTable(tableBytes);
+    }
+    if (!replayPath.empty())
+    {
+        return PlayReplay(replayPath, mode, allocBudget);
+    }
+    if (perftCheck)
+    {
+        return RunPerftCheck(numThreads, tableBytes > 0 ? tableBytes : (size_t)16 << 20);
+    }
+    if (perftDepth > 0)
+    {
+        return RunPerft(seed, perftGarbage, perftDepth, numThreads, perftDistinct, tableBytes);
+    }
+
+    // The input policy has its own generator so it never disturbs the engine's pieces.
+    // It holds each input for a few ticks, the same runs drive every mode. The bot
+    // instead picks a fresh input every tick.
+    std::mt19937 policyRng((unsigned int)seed);
+    Engine engine;
+    Engine reference;
+    Replay replay;
+    SimulationTotals totals = {0, 0, 0, 0, 0};
+    long totalRuns = 0;
+    long totalScore = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int game = 0; game < numGames; game++)
+    {
+        uint64_t gameSeed = seed + game;
+        engine.Reset(gameSeed, gravity);
+        reference.Reset(gameSeed, gravity);
+        if (game == 0)
+        {
+            replay.Reset(gameSeed, gravity);
+        }
+        bot.Reset();
+        while (engine.GetTickCount() < maxTicksPerGame && !engine.IsGameOver())
+        {
+            PolicyRun run = useBot ? PolicyRun{bot.NextInput(engine), 1} : RandomInputRun(policyRng);
+            int64_t simulated = PlayRun(engine, reference, run.input, run.ticks, mode, totals);
+            if (game == 0 && !recordPath.empty())
+            {
+                for (int64_t tick = 0; tick < simulated; tick++)
+                {
+                    replay.Record(run.input);
+                }
+            }
+            totalRuns++;
+        }
+        totalScore += engine.GetScore();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!recordPath.empty() && !replay.Save(recordPath))
+    {
+        printf("Failed to save replay %s\n", recordPath.c_str());
+        return 1;
+    }
+
+    printf("games: %d\n", numGames);
+    printf("ticks: %ld\n", totals.ticks);
+    printf("simulated time: %.1f s\n", (double)totals.ticks / ticksPerSecond);
+    printf("pieces: %ld\n", totals.pieces);
+    printf("lines: %ld\n", totals.lines);
+    printf("average score: %.1f\n", numGames > 0 ? (double)totalScore / numGames : 0.0);
+    printf("time: %.3f s\n", seconds);
+    if (seconds > 0.0)
+    {
+        printf("ticks/s: %.0f\n", totals.ticks / seconds);
+        printf("pieces/s: %.0f\n", totals.pieces / seconds);
+    }
+    if (useBot)
+    {
+        printf("bot placements evaluated: %lld\n", (long long)bot.GetPlacementsEvaluated());
+        if (seconds > 0.0)
+        {
+            printf("bot placements/s: %.0f\n", bot.GetPlacementsEvaluated() / seconds);
+        }
+        const BotSearchStats& search = bot.GetSearchStats();
+        if (search.searches > 0)
+        {
+            printf("bot searches: %lld, %.0f nodes each\n", (long long)search.searches, (double)search.nodes / search.searches);
+            printf("bot search time: %.3f ms average, %.3f ms slowest\n", search.seconds * 1e3 / search.searches, search.maxSeconds * 1e3);
+        }
+        if (bot.GetBeamDepth() > 0)
+        {
+            printf("bot beam: width %d, depth %d, arena %zu KB, %.1f duplicate boards dropped per search\n", bot.GetBeamWidth(),
+                   bot.GetBeamDepth(), search.arenaBytes / 1024, (double)search.duplicates / search.searches);
+        }
+        if (bot.GetRolloutDepth() > 0 && search.searches > 0)
+        {
+            printf("bot rollouts: depth %d, %.1f per search on %d threads, %.0f rollouts/s\n", bot.GetRolloutDepth(),
+                   (double)search.rollouts / search.searches, bot.GetRolloutThreads(),
+                   search.seconds > 0.0 ? search.rollouts / search.seconds : 0.0);
+        }
+        if (bot.GetFeatureTableBytes() > 0)
+        {
+            printf("bot feature table: %zu MB, %.1f%% hits of %lld probes\n", bot.GetFeatureTableBytes() >> 20,
+                   search.tableProbes > 0 ? 100.0 * search.tableHits / search.tableProbes : 0.0, (long long)search.tableProbes);
+        }
+    }
+    if (mode == ModeVerify)
+    {
+        printf("verify: %ld runs, %ld mismatches\n", totalRuns, totals.mismatches);
+        return totals.mismatches == 0 ? 0 : 1;
+    }
+    return 0;
+}